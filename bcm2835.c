@@ -18,6 +18,7 @@
 #include <sys/mman.h>
 #include <string.h>
 #include <time.h>
+#include <pthread.h>
 #include <unistd.h>
 #include <sys/types.h>
 
@@ -70,6 +71,28 @@ volatile uint32_t *bcm2835_smi         = (uint32_t *)MAP_FAILED;
  */
 static uint8_t debug = 0;
 
+/* This variable makes bcm2835_init map a heap-backed fake peripheral block.
+   Accesses go to emulated registers and are logged, so the real code paths run off-target
+ */
+static uint8_t fake = 0;
+
+/* Fake mode state: access log ring, user hook, SPI0 RX FIFO and the emulated MAX7219 shift register
+ */
+#define FAKE_SPI_FIFO_LEN 64
+#define FAKE_SPI_SHIFT_LEN 2
+
+/* The access log is written by the thread driving the peripherals and read by any other,
+   fake_log_lock keeps the entries whole
+ */
+static bcm2835_fake_access fake_log_ring[BCM2835_FAKE_LOG_LEN];
+static uint64_t fake_log_head = 0;
+static pthread_mutex_t fake_log_lock = PTHREAD_MUTEX_INITIALIZER;
+static bcm2835_fake_hook fake_hook = NULL;
+static uint8_t fake_spi_rx[FAKE_SPI_FIFO_LEN];
+static uint32_t fake_spi_rx_head = 0;
+static uint32_t fake_spi_rx_tail = 0;
+static uint8_t fake_spi_shift[FAKE_SPI_SHIFT_LEN];
+
 /* RPI 4 has different pullup registers - we need to know if we have that type */
 
 static uint8_t pud_type_rpi4 = 0;
@@ -190,6 +213,127 @@ void  bcm2835_set_debug(uint8_t d)
     debug = d;
 }
 
+void  bcm2835_set_fake(uint8_t f)
+{
+    fake = f;
+}
+
+void  bcm2835_fake_set_hook(bcm2835_fake_hook hook)
+{
+    fake_hook = hook;
+}
+
+uint32_t bcm2835_fake_log(bcm2835_fake_access* entries, uint32_t max)
+{
+    uint32_t n = 0;
+    uint64_t index;
+
+    if (max > BCM2835_FAKE_LOG_LEN)
+	max = BCM2835_FAKE_LOG_LEN;
+
+    /* Copies the newest entries, oldest first, and leaves them in the log for other readers */
+    pthread_mutex_lock(&fake_log_lock);
+    index = fake_log_head > max ? fake_log_head - max : 0;
+    while (index < fake_log_head)
+	entries[n++] = fake_log_ring[index++ % BCM2835_FAKE_LOG_LEN];
+    pthread_mutex_unlock(&fake_log_lock);
+    return n;
+}
+
+uint64_t bcm2835_fake_access_count(void)
+{
+    uint64_t count;
+
+    pthread_mutex_lock(&fake_log_lock);
+    count = fake_log_head;
+    pthread_mutex_unlock(&fake_log_lock);
+    return count;
+}
+
+static uint64_t bcm2835_fake_now_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static void bcm2835_fake_record(uint32_t offset, uint32_t value, uint8_t write)
+{
+    uint64_t now = bcm2835_fake_now_ns();
+    bcm2835_fake_access* entry;
+
+    pthread_mutex_lock(&fake_log_lock);
+    entry = &fake_log_ring[fake_log_head++ % BCM2835_FAKE_LOG_LEN];
+    entry->time_ns = now;
+    entry->offset = offset;
+    entry->value = value;
+    entry->write = write;
+    pthread_mutex_unlock(&fake_log_lock);
+}
+
+/* Read from the fake peripheral block, emulating the registers the display code polls */
+static uint32_t bcm2835_fake_read(volatile uint32_t* paddr)
+{
+    uint32_t offset = (uint32_t)((paddr - bcm2835_peripherals) * 4);
+    uint32_t value = *paddr;
+
+    if (offset == BCM2835_ST_BASE + BCM2835_ST_CLO)
+	value = (uint32_t)(bcm2835_fake_now_ns() / 1000);
+    else if (offset == BCM2835_ST_BASE + BCM2835_ST_CHI)
+	value = (uint32_t)(bcm2835_fake_now_ns() / 1000 >> 32);
+    else if (offset == BCM2835_SPI0_BASE + BCM2835_SPI0_CS)
+    {
+	/* Transfers complete instantly */
+	value |= BCM2835_SPI0_CS_TXD | BCM2835_SPI0_CS_DONE;
+	if (fake_spi_rx_head != fake_spi_rx_tail)
+	    value |= BCM2835_SPI0_CS_RXD;
+    }
+    else if (offset == BCM2835_SPI0_BASE + BCM2835_SPI0_FIFO)
+    {
+	value = 0;
+	if (fake_spi_rx_head != fake_spi_rx_tail)
+	    value = fake_spi_rx[fake_spi_rx_tail++ % FAKE_SPI_FIFO_LEN];
+    }
+
+    if (fake_hook)
+	value = fake_hook(offset, value, 0);
+    bcm2835_fake_record(offset, value, 0);
+    return value;
+}
+
+/* Write to the fake peripheral block */
+static void bcm2835_fake_write(volatile uint32_t* paddr, uint32_t value)
+{
+    uint32_t offset = (uint32_t)((paddr - bcm2835_peripherals) * 4);
+
+    if (offset == BCM2835_GPIO_BASE + BCM2835_GPSET0 || offset == BCM2835_GPIO_BASE + BCM2835_GPSET1)
+	bcm2835_peripherals[(offset - BCM2835_GPSET0 + BCM2835_GPLEV0) / 4] |= value;
+    else if (offset == BCM2835_GPIO_BASE + BCM2835_GPCLR0 || offset == BCM2835_GPIO_BASE + BCM2835_GPCLR1)
+	bcm2835_peripherals[(offset - BCM2835_GPCLR0 + BCM2835_GPLEV0) / 4] &= ~value;
+    else if (offset == BCM2835_SPI0_BASE + BCM2835_SPI0_CS)
+    {
+	if (value & BCM2835_SPI0_CS_CLEAR_RX)
+	    fake_spi_rx_tail = fake_spi_rx_head;
+	/* CLEAR bits are write-only */
+	*paddr = value & ~BCM2835_SPI0_CS_CLEAR;
+    }
+    else if (offset == BCM2835_SPI0_BASE + BCM2835_SPI0_FIFO)
+    {
+	/* MISO sees the byte shifted in 16 clocks earlier, the oldest RX byte is dropped on overflow */
+	if (fake_spi_rx_head - fake_spi_rx_tail == FAKE_SPI_FIFO_LEN)
+	    fake_spi_rx_tail++;
+	fake_spi_rx[fake_spi_rx_head++ % FAKE_SPI_FIFO_LEN] = fake_spi_shift[0];
+	memmove(fake_spi_shift, fake_spi_shift + 1, FAKE_SPI_SHIFT_LEN - 1);
+	fake_spi_shift[FAKE_SPI_SHIFT_LEN - 1] = (uint8_t)value;
+    }
+    else
+	*paddr = value;
+
+    if (fake_hook)
+	fake_hook(offset, value, 1);
+    bcm2835_fake_record(offset, value, 1);
+}
+
 unsigned int bcm2835_version(void) 
 {
     return BCM2835_VERSION;
@@ -206,6 +350,8 @@ uint32_t bcm2835_peri_read(volatile uint32_t* paddr)
 		printf("bcm2835_peri_read  paddr %p\n", (void *) paddr);
 		return 0;
     }
+    else if (fake)
+	return bcm2835_fake_read(paddr);
     else
     {
        __sync_synchronize();
@@ -228,6 +374,8 @@ uint32_t bcm2835_peri_read_nb(volatile uint32_t* paddr)
 	printf("bcm2835_peri_read_nb  paddr %p\n", paddr);
 	return 0;
     }
+    else if (fake)
+	return bcm2835_fake_read(paddr);
     else
     {
 	return *paddr;
@@ -243,6 +391,8 @@ void bcm2835_peri_write(volatile uint32_t* paddr, uint32_t value)
     {
 	printf("bcm2835_peri_write paddr %p, value %08X\n", paddr, value);
     }
+    else if (fake)
+	bcm2835_fake_write(paddr, value);
     else
     {
         __sync_synchronize();
@@ -259,6 +409,8 @@ void bcm2835_peri_write_nb(volatile uint32_t* paddr, uint32_t value)
 	printf("bcm2835_peri_write_nb paddr %p, value %08X\n",
                 paddr, value);
     }
+    else if (fake)
+	bcm2835_fake_write(paddr, value);
     else
     {
 	*paddr = value;
@@ -1986,9 +2138,24 @@ int bcm2835_init(void)
     int  ok;
     FILE *fp;
 
-    if (debug) 
+    if (debug || fake) 
     {
         bcm2835_peripherals = (uint32_t*)BCM2835_PERI_BASE;
+	if (fake)
+	{
+	    /* Zeroed pages are only allocated once touched */
+	    bcm2835_peripherals = calloc(1, bcm2835_peripherals_size);
+	    if (!bcm2835_peripherals)
+	    {
+		bcm2835_peripherals = MAP_FAILED;
+		return 0;
+	    }
+	    pthread_mutex_lock(&fake_log_lock);
+	    fake_log_head = 0;
+	    pthread_mutex_unlock(&fake_log_lock);
+	    fake_spi_rx_head = fake_spi_rx_tail = 0;
+	    memset(fake_spi_shift, 0, sizeof(fake_spi_shift));
+	}
 
 	bcm2835_pads = bcm2835_peripherals + BCM2835_GPIO_PADS/4;
 	bcm2835_clk  = bcm2835_peripherals + BCM2835_CLOCK_BASE/4;
@@ -2140,7 +2307,13 @@ int bcm2835_close(void)
 {
     if (debug) return 1; /* Success */
 
-    unmapmem((void**) &bcm2835_peripherals, bcm2835_peripherals_size);
+    if (fake)
+    {
+	if (bcm2835_peripherals != MAP_FAILED)
+	    free(bcm2835_peripherals);
+    }
+    else
+	unmapmem((void**) &bcm2835_peripherals, bcm2835_peripherals_size);
     bcm2835_peripherals = MAP_FAILED;
     bcm2835_gpio = MAP_FAILED;
     bcm2835_pwm  = MAP_FAILED;
@@ -1369,6 +1369,21 @@ typedef enum
 extern "C" {
 #endif
 
+    /*! Number of peripheral accesses kept in the fake mode access log */
+#define BCM2835_FAKE_LOG_LEN 4096
+
+    /*! A peripheral access recorded in fake mode */
+    typedef struct
+    {
+	uint64_t time_ns;   /*!< CLOCK_MONOTONIC time of the access */
+	uint32_t offset;    /*!< Offset from the peripheral base */
+	uint32_t value;     /*!< Value read or written */
+	uint8_t  write;     /*!< 1 for writes, 0 for reads */
+    } bcm2835_fake_access;
+
+    /*! Hook emulating a peripheral in fake mode, see bcm2835_fake_set_hook() */
+    typedef uint32_t (*bcm2835_fake_hook)(uint32_t offset, uint32_t value, uint8_t write);
+
     /*! \defgroup init Library initialisation and management
       These functions allow you to intialise and control the bcm2835 library
       @{
@@ -1403,6 +1418,40 @@ extern "C" {
     */
     extern void  bcm2835_set_debug(uint8_t debug);
 
+    /*! Sets the fake peripheral mode of the library.
+      A value of 1 makes bcm2835_init() map a zeroed, heap-backed peripheral block instead of /dev/mem,
+      so the real SPI and GPIO code paths run off-target at full speed.
+      Every peripheral access is logged with a CLOCK_MONOTONIC timestamp and emulated:
+      GPSETn/GPCLRn drive GPLEVn, the System Timer counts real microseconds,
+      SPI0 is always DONE and its FIFO loops MOSI back to MISO through a 16-bit shift register,
+      like DOUT of a single MAX7219.
+      Call this before calling bcm2835_init();
+      \param[in] fake The new fake mode. 1 means fake
+    */
+    extern void  bcm2835_set_fake(uint8_t fake);
+
+    /*! Sets a hook called on every peripheral access in fake mode, after the built-in emulation.
+      For reads, the hook's return value is what the read returns, for writes it is ignored.
+      \param[in] hook The hook, called with the offset from the peripheral base, the value read or written
+      and 1 for writes, NULL to remove it
+    */
+    extern void  bcm2835_fake_set_hook(bcm2835_fake_hook hook);
+
+    /*! Copies the newest logged peripheral accesses out of the fake mode access log,
+      without removing them, so every reader sees the same log. Safe to call from any thread.
+      The log keeps the last BCM2835_FAKE_LOG_LEN accesses.
+      \param[out] entries Buffer for the accesses, oldest first
+      \param[in] max Number of accesses that fit in entries
+      \return Number of accesses copied
+    */
+    extern uint32_t bcm2835_fake_log(bcm2835_fake_access* entries, uint32_t max);
+
+    /*! Number of peripheral accesses since bcm2835_init() in fake mode, including the ones
+      that no longer fit in the log
+      \return Number of accesses
+    */
+    extern uint64_t bcm2835_fake_access_count(void);
+
     /*! Returns the version number of the library, same as BCM2835_VERSION
        \return the current library version number
     */
@@ -5,5 +5,15 @@
 #define BCM_BITBANG_LOAD_PIN 27 // = bcm2835.h RPI_V2_GPIO_P1_13
 #define BCM_BITBANG_CLK_PIN 22  // = bcm2835.h RPI_V2_GPIO_P1_15
 
-#define BCM_BITBANG_DELAY_USEC 100
-#endif //BCM_BITBANG_H
\ No newline at end of file
+// DIN pins of displays sharing CLK and LOAD, lane 0 is BCM_BITBANG_DIN_PIN
+#define BCM_BITBANG_MAX_LANES 8
+#define BCM_BITBANG_LANE_DIN_PINS {BCM_BITBANG_DIN_PIN, 23, 24, 25, 5, 6, 12, 13}
+
+// MAX7219 serial interface timing minimums are 50 ns for CLK high/low and LOAD high,
+// these are doubled for wiring margin
+#define BCM_BITBANG_HALF_PERIOD_NS 100 // CLK high and CLK low time, 5 MHz bit clock
+#define BCM_BITBANG_LOAD_WIDTH_NS 100 // LOAD high time after latching
+
+// Busy loop iterations timed against the system timer at init
+#define BCM_BITBANG_CALIBRATION_LOOPS 1000000
+#endif //BCM_BITBANG_H
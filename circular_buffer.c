@@ -1,6 +1,7 @@
 #include "circular_buffer.h"
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 
 void circular_buffer_init(struct CircularBuffer* cb)
 {
@@ -11,6 +12,8 @@ void circular_buffer_init(struct CircularBuffer* cb)
 
     cb->len = (uint8_t) 0;
     cb->firstDisplayed = cb->data;
+    cb->frameCount = (uint8_t) 1;
+    cb->frameIndex = (uint8_t) 0;
 }
 
 void circular_buffer_advance(struct CircularBuffer* cb, uint8_t** dataPtr)
@@ -35,3 +38,40 @@ void circular_buffer_advance(struct CircularBuffer* cb, uint8_t** dataPtr)
     //printf("circular_buffer_advanced to %d\n", *dataPtr);
     return;
 }
+
+void circular_buffer_compile(struct CircularBuffer* cb, int frameLen)
+{
+    int frameBytes = cb->len + frameLen - 1;
+
+    cb->frameIndex = 0;
+
+    //a message that fits doesn't scroll
+    if (cb->len <= frameLen)
+    {
+        memcpy(cb->frames, cb->data, cb->len);
+        memset(cb->frames + cb->len, 0, frameLen - cb->len);
+        cb->frameCount = 1;
+        return;
+    }
+
+    //the message repeats until the last frame is complete
+    for (int i = 0; i < frameBytes; i++)
+    {
+        cb->frames[i] = cb->data[i % cb->len];
+    }
+    cb->frameCount = cb->len;
+}
+
+const uint8_t* circular_buffer_frame(const struct CircularBuffer* cb)
+{
+    return &cb->frames[cb->frameIndex];
+}
+
+void circular_buffer_next_frame(struct CircularBuffer* cb)
+{
+    cb->frameIndex++;
+    if (cb->frameIndex >= cb->frameCount)
+    {
+        cb->frameIndex = 0;
+    }
+}
@@ -17,6 +17,9 @@
 
 #define CIRC_BUFF_MAX_OUT_LEN 128
 
+/** @brief Max number of digits in a frame, every digit of 64 chained MAX7219s */
+#define CIRC_BUFF_MAX_FRAME_LEN 512
+
 struct CircularBuffer
 {
     /** @brief Contains values of characters that are to be displayed */
@@ -27,6 +30,19 @@ struct CircularBuffer
 
     /** @brief Read pointer. Points to the member that is to be displayed on the first slot of the 7seg display */
     uint8_t* firstDisplayed;
+
+    /**
+     * @brief Every scroll frame, compiled by circular_buffer_compile.
+     * The message is unrolled as many times as a frame needs, so frame `i` is the
+     * `frameLen` bytes starting at frames[i], for `i` from 0 to frameCount - 1.
+     */
+    uint8_t frames[CIRC_BUFF_MAX_OUT_LEN + CIRC_BUFF_MAX_FRAME_LEN];
+
+    /** @brief Number of scroll frames, 1 if the message fits a frame and doesn't scroll */
+    uint8_t frameCount;
+
+    /** @brief Frame to be displayed next */
+    uint8_t frameIndex;
 };
 
 /** @brief Initializes the circular buffer */
@@ -35,5 +51,18 @@ void circular_buffer_init(struct CircularBuffer* cb);
 /** @brief Moves the passed pointer one place forward */
 void circular_buffer_advance(struct CircularBuffer* cb, uint8_t** dataPtr);
 
+/**
+ * @brief Renders every scroll frame of `frameLen` digits once, after the data is added,
+ * so showing a frame takes no computation.
+ * A message that fits a frame is a single frame, padded with blank digits on the right.
+ */
+void circular_buffer_compile(struct CircularBuffer* cb, int frameLen);
+
+/** @brief Frame to be displayed next, `frameLen` digits, leftmost first */
+const uint8_t* circular_buffer_frame(const struct CircularBuffer* cb);
+
+/** @brief Moves to the next scroll frame, back to the first after the last */
+void circular_buffer_next_frame(struct CircularBuffer* cb);
+
 
 #endif //CIRCULAR_BUFFER_H
\ No newline at end of file
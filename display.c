@@ -1,6 +1,9 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdatomic.h>
+#include <errno.h>
 #include <inttypes.h>
 #include <pthread.h>
 #include <unistd.h> //for sleep
@@ -9,38 +12,40 @@
 #include "bcm2835.h"
 #include "max7219_types.h"
 #include "circular_buffer.h"
-#include "bcm_bitbang.h"
+#include "transport.h"
+#include "trace.h"
+#include "glyph.h"
+#include "ticker.h"
+#include "message_cache.h"
 
 
-/** @brief Uses bcm2835 library with SPI pins and functions */
-#define USE_BCM2835_SPI_LIB 0
+#define DISPLAY_MAX_STR_LEN 128
 
-/** @brief Uses bcm2835 library GPIO functions to bitbang the MAX2019 spi */
-#define USE_BCM2835_BITBANG_LIB 0
+/** @brief Time between two scroll frames if DISPLAY_SCROLL_MS isn't set */
+#define DISPLAY_SCROLL_MS_DEFAULT 500
 
-/** @brief Bitbangs with Linux kernel and GPIO pins */
-#define USE_GPIO_BITBANG_LIB 1
+#define DISPLAY_NS_PER_MS 1000000LL
+#define DISPLAY_NS_PER_SEC 1000000000LL
 
-#define DEV_FN "/dev/gpio_bitbang"
+/** @brief Message buffers the update thread may hold: the one it shows and the one handed over */
+#define DISPLAY_BUFF_HELD 2
 
+/** @brief Set in `pendingBuff` while it holds a message the update thread hasn't picked up */
+#define DISPLAY_BUFF_FRESH 0x100
 
-/**
- * @brief Helper macro for error handling
- *
- * @note Guaranteed to only perform one evaluation of `status`
- */
-#define DISPLAY_FAIL_UNLESS_OK(status) \
-    do                                \
-    {                                 \
-        int temp = (status);          \
-        if (1 != temp)                \
-        {                             \
-            return temp;              \
-        }                             \
-    } while (0)
+_Static_assert(TRANSPORT_FRAME_LEN * TRANSPORT_MAX_CHIPS <= CIRC_BUFF_MAX_FRAME_LEN,
+    "compiled scroll frames must fit every digit of the longest sign");
+_Static_assert(DISPLAY_MAX_STR_LEN <= CIRC_BUFF_MAX_OUT_LEN,
+    "an encoded message has at most one digit per input character");
+_Static_assert(DISPLAY_MAX_STR_LEN <= MESSAGE_CACHE_TEXT_LEN,
+    "every input line must fit as a message cache key");
+_Static_assert(MESSAGE_CACHE_LEN <= DISPLAY_BUFF_FRESH && MESSAGE_CACHE_LEN > DISPLAY_BUFF_HELD,
+    "cache entries are handed over by index, and one must be left to encode into");
+_Static_assert(TRANSPORT_FRAME_LEN * TRANSPORT_MAX_CHIPS + DISPLAY_MAX_STR_LEN + 1 <= TICKER_RING_LEN,
+    "an input line and its separator must fit in the ticker next to the longest window");
 
-#define DISPLAY_MAX_STR_LEN 128
-#define DISPLAY_INSTR_LEN 2
+/** @brief Fake peripheral accesses further apart than this are in separate updates */
+#define DISPLAY_FAKE_IDLE_NS 100000
 
 
 enum DisplayState
@@ -53,141 +58,198 @@ struct DisplayContext
 {
     /** @brief Contains current device state*/
     enum DisplayState state;
-    /** @brief Current/last SPI instruction sent to the display */
-    char instr[DISPLAY_INSTR_LEN];
+    /** @brief Backend that delivers instructions to the display */
+    const struct Transport* transport;
+    /** @brief Number of digits of all displays, on all lanes */
+    int digitCount;
+    /** @brief Tells if bcm2835 runs on a fake peripheral block */
+    bool fakePeripherals;
+    /** @brief Time between two scroll frames */
+    int64_t framePeriodNs;
+    /** @brief Frames shown, deadlines missed and how late frames started, kept by the update thread */
+    atomic_uint_fast64_t framesShown;
+    atomic_uint_fast64_t deadlinesMissed;
+    atomic_uint_fast64_t latenessTotalNs;
+    atomic_uint_fast64_t latenessMaxNs;
+    /** @brief Wakes the update thread for new content, it sleeps on it while the content is static */
+    pthread_mutex_t wakeLock;
+    pthread_cond_t wakeCond;
     /** @brief Stores user input*/
     char userInput[DISPLAY_MAX_STR_LEN];
-    /** @brief Buffer used to store characters to be displayed */
-    struct CircularBuffer outBuff;
-    /** @brief Read/write pointer of `outBuff` */
-    int outBuffIndex;
-    /** @brief Tells if current character's dot LED displays a dot */
-    bool dotDisplayed;
+    /**
+     * @brief Encoded messages, their entries are the buffers used to store characters to be displayed.
+     * The update thread owns the front entry, the input thread encodes into any entry it doesn't hold,
+     * and they swap the handed over one through `pendingBuff` without waiting for each other.
+     */
+    struct MessageCache cache;
+    /** @brief Entries the update thread may hold, the last one handed over first, kept by the input thread */
+    int heldBuffs[DISPLAY_BUFF_HELD];
+    /** @brief Index of the handed over entry, with DISPLAY_BUFF_FRESH if it holds a new message */
+    atomic_int pendingBuff;
+    /** @brief Glyphs streamed in ticker mode, the input thread appends and the update thread scrolls them */
+    struct Ticker ticker;
+    /** @brief Tells if input lines are appended to the ticker instead of replacing the message */
+    atomic_bool tickerMode;
+    /** @brief Tells if lines that don't fit in the ticker wait for room, instead of being dropped */
+    bool tickerWait;
+    /** @brief Messages published, and messages replaced by a newer one before the update thread took them */
+    uint64_t messagesPublished;
+    uint64_t messagesReplaced;
+    /** @brief Ticker lines that had to wait for the update thread to make room */
+    uint64_t tickerWaits;
     /** @brief Thread that updates the display*/
     pthread_t updateThread;
     /** @brief Contains the information if first advertisement is being displayed */
     bool firstTime;
     /** @brief Exit command that user needs to write to terminate the program: default is "exit"*/
     char exitCommand[5];
-
-
-    /** @brief File descriptor for the gpio_bitbang driver*/
-    int gpio_fd;
+    /** @brief Commands that turn the instruction trace on/off and print it */
+    char traceOnCommand[9];
+    char traceOffCommand[10];
+    char traceDumpCommand[6];
+    /** @brief Command that prints the transport's counters */
+    char statsCommand[6];
+    /** @brief Command that resends every register, for a display that lost its state */
+    char refreshCommand[8];
+    /** @brief Command that benchmarks the glyph encoders */
+    char benchCommand[6];
+    /** @brief Commands that turn the streaming ticker on/off */
+    char tickerOnCommand[10];
+    char tickerOffCommand[11];
 };
 
 static struct DisplayContext context = {
     .state = DISPLAY_STATE_UNINITIALIZED,
-    .outBuffIndex = -1,
-    .instr = {0},
-    .dotDisplayed = false,
+    .heldBuffs = {1, 0},
+    .pendingBuff = 1,
+    .transport = NULL,
+    .digitCount = TRANSPORT_FRAME_LEN,
+    .framePeriodNs = DISPLAY_SCROLL_MS_DEFAULT * DISPLAY_NS_PER_MS,
+    .wakeLock = PTHREAD_MUTEX_INITIALIZER,
     .userInput = {0},
     .firstTime = true,
-    .exitCommand = "exit"
+    .exitCommand = "exit",
+    .traceOnCommand = "trace on",
+    .traceOffCommand = "trace off",
+    .traceDumpCommand = "trace",
+    .statsCommand = "stats",
+    .refreshCommand = "refresh",
+    .benchCommand = "bench",
+    .tickerOnCommand = "ticker on",
+    .tickerOffCommand = "ticker off"
 };
 
-static void display_spi_write(char reg, char val)
+/**
+ * @brief Submits `count` packed instructions, a full frame goes out in one transport call.
+ * Registers that already hold their value are skipped.
+ */
+static void display_spi_write_batch(const uint16_t* instrs, int count)
 {
-#if USE_BCM2835_SPI_LIB
+    transport_write_batch(context.transport, instrs, count);
+}
 
-    context.instr[0] = reg;
-    context.instr[1] = val;
-    bcm2835_spi_writenb(context.instr, DISPLAY_INSTR_LEN);
+/**
+ * @brief Submits `context.digitCount` digits, leftmost first, one chain frame per digit row.
+ * Digits that already show their value are skipped.
+ */
+static void display_spi_write_frame(const uint8_t* digits)
+{
+    transport_write_frame(context.transport, digits);
+}
 
-#elif USE_GPIO_BITBANG_LIB
-    uint16_t instr = ((uint16_t)reg<<8) | (uint16_t)val;
-    printf("bbb: %x|%x\n", reg, val);
-    int status = write(context.gpio_fd, (char*)&instr, sizeof(instr));
+int display_init(const char* transportName)
+{   
+    //Tracing can be turned on before the first instruction
+    const char* traceEnv = getenv("DISPLAY_TRACE");
+    trace_enable(traceEnv != NULL && strcmp(traceEnv, "1") == 0);
+
+    //bcm2835 transports can run on a fake peripheral block, off the Pi
+    const char* fakeEnv = getenv("DISPLAY_FAKE_PERI");
+    context.fakePeripherals = fakeEnv != NULL && strcmp(fakeEnv, "1") == 0;
+    bcm2835_set_fake(context.fakePeripherals);
+
+    //Scroll rate
+    const char* scrollEnv = getenv("DISPLAY_SCROLL_MS");
+    if (scrollEnv != NULL && atoi(scrollEnv) > 0)
+    {
+        context.framePeriodNs = atoi(scrollEnv) * DISPLAY_NS_PER_MS;
+    }
 
-#elif USE_BCM2835_BITBANG_LIB
-    uint16_t bits = ((uint16_t)reg<<8) | (uint16_t)val;
-    //bitbangbits
-    printf("bbb: %x|%x\n", reg, val);
+    //A ticker feed faster than the scroll is slowed down instead of losing lines
+    const char* waitEnv = getenv("DISPLAY_TICKER_WAIT");
+    context.tickerWait = waitEnv != NULL && strcmp(waitEnv, "1") == 0;
 
-    bcm2835_gpio_set(BCM_BITBANG_LOAD_PIN);
-    usleep(BCM_BITBANG_DELAY_USEC);
+    //Wakes the update thread, initialized once before anything can be published
+    //Scroll deadlines are on CLOCK_MONOTONIC
+    pthread_condattr_t condAttr;
+    pthread_condattr_init(&condAttr);
+    pthread_condattr_setclock(&condAttr, CLOCK_MONOTONIC);
+    pthread_cond_init(&context.wakeCond, &condAttr);
+    pthread_condattr_destroy(&condAttr);
 
-    for (int i = 16; i > 0; i--)
+    //Transport initialization
+    if (transportName == NULL)
     {
-        // Calculate bitmask, MSB first, LSB last
-        unsigned short mask = 1 << (i - 1); 
-
-        // Write a bit to DIN while the CLK is cleared
-        bcm2835_gpio_clr(BCM_BITBANG_CLK_PIN);
-        usleep(BCM_BITBANG_DELAY_USEC);
-
-        // Write the current data bit
-        if (bits & mask)
+        context.transport = transport_probe();
+        if (context.transport == NULL)
         {
-            bcm2835_gpio_set(BCM_BITBANG_DIN_PIN);
+            printf("ERROR: no transport available!\n");
+            return 3;
         }
-        else
+    }
+    else
+    {
+        context.transport = transport_find(transportName);
+        if (context.transport == NULL)
         {
-            bcm2835_gpio_clr(BCM_BITBANG_DIN_PIN);
+            printf("ERROR: unknown transport \"%s\"!\n", transportName);
+            return 2;
         }
-        usleep(BCM_BITBANG_DELAY_USEC);
 
-        // Processes the bit on the rising edge
-        bcm2835_gpio_set(BCM_BITBANG_CLK_PIN);
-        usleep(BCM_BITBANG_DELAY_USEC);
+        int initStatus = context.transport->init();
+        if (initStatus != 0)
+        {
+            return initStatus;
+        }
     }
+    printf("Using transport: %s\n", context.transport->name);
 
-    // Stops the data input
-    bcm2835_gpio_clr(BCM_BITBANG_LOAD_PIN);
-    usleep(BCM_BITBANG_DELAY_USEC);
-    bcm2835_gpio_set(BCM_BITBANG_LOAD_PIN);
-    usleep(BCM_BITBANG_DELAY_USEC);
-
-#endif
-}
-
-int display_init()
-{   
-    //Pin initialization
-    int status = 0;
-
-#if USE_BCM2835_SPI_LIB
-
-    status = bcm2835_init();
-    DISPLAY_FAIL_UNLESS_OK(status);
-    printf("bcm2835 init\n");
-    status = bcm2835_spi_begin();
-    DISPLAY_FAIL_UNLESS_OK(status);
-    printf("bcm2835 init\n");
-
-    bcm2835_spi_chipSelect(BCM2835_SPI_CS0);
-    bcm2835_spi_setClockDivider(BCM2835_SPI_CLOCK_DIVIDER_32768);
-
-#elif USE_GPIO_BITBANG_LIB
-
-    context.gpio_fd = open(DEV_FN, O_RDWR);
-	if(context.gpio_fd < 0)
+    //Daisy-chained displays, also resets the register shadow, display state is unknown
+    const char* chainEnv = getenv("DISPLAY_CHAIN_LEN");
+    int chainLen = chainEnv != NULL ? atoi(chainEnv) : 1;
+    int status = transport_set_chain_len(context.transport, chainLen);
+    if (status != 0)
     {
-		printf("ERROR: \"%s\" not opened!\n", DEV_FN);
-		return 4;
-	}
-    printf("gpio_bitbang kernel driver opened, %d!\n", context.gpio_fd);
-    DISPLAY_FAIL_UNLESS_OK(status);
-
-#elif USE_BCM2835_BITBANG_LIB
-
-    status = bcm2835_init();
-    DISPLAY_FAIL_UNLESS_OK(status);
-
-    // Configures the neccessary GPIO pins into output pins
-    bcm2835_gpio_fsel(BCM_BITBANG_DIN_PIN, BCM2835_GPIO_FSEL_OUTP); //RPI_V2_GPIO_P1_11
-    bcm2835_gpio_fsel(BCM_BITBANG_LOAD_PIN, BCM2835_GPIO_FSEL_OUTP); //RPI_V2_GPIO_P1_13
-    bcm2835_gpio_fsel(BCM_BITBANG_CLK_PIN, BCM2835_GPIO_FSEL_OUTP); //RPI_V2_GPIO_P1_15
-
-#endif
+        printf("ERROR: chain of %d displays not supported!\n", chainLen);
+        context.transport->close();
+        return status;
+    }
 
-    display_spi_write(REG_SCAN_LIMIT, SCAN_LIMIT_7);
-    display_spi_write(REG_DECODE_MODE, DECODE_OFF);
-    display_spi_write(REG_DISPLAY_TEST, TEST_MODE_OFF);
-    display_spi_write(REG_INTENSITY, INTENSITY_31_32);
-    display_spi_write(REG_SHUTDOWN, SHUTDOWN_5V);
+    //Chains with their own DIN line, sharing CLK and LOAD
+    const char* lanesEnv = getenv("DISPLAY_LANES");
+    int lanes = lanesEnv != NULL ? atoi(lanesEnv) : 1;
+    status = transport_set_lanes(context.transport, lanes);
+    if (status != 0)
+    {
+        printf("ERROR: %d display lanes not supported by %s!\n", lanes, context.transport->name);
+        context.transport->close();
+        return status;
+    }
+    context.digitCount = transport_chip_count() * TRANSPORT_FRAME_LEN;
+
+    //Every chip in the chain gets the same configuration
+    const uint16_t config[] = {
+        TRANSPORT_INSTR(REG_SCAN_LIMIT, SCAN_LIMIT_7),
+        TRANSPORT_INSTR(REG_DECODE_MODE, DECODE_OFF),
+        TRANSPORT_INSTR(REG_DISPLAY_TEST, TEST_MODE_OFF),
+        TRANSPORT_INSTR(REG_INTENSITY, INTENSITY_31_32),
+        TRANSPORT_INSTR(REG_SHUTDOWN, SHUTDOWN_5V)
+    };
+    display_spi_write_batch(config, sizeof(config) / sizeof(config[0]));
 
     //Context initialization
-    circular_buffer_init(&context.outBuff);
+    message_cache_init(&context.cache);
+    ticker_init(&context.ticker, context.digitCount);
     context.state = DISPLAY_STATE_INITIALIZED;
     return 0;
 }
@@ -195,148 +257,252 @@ int display_init()
 void display_destroy()
 {
     printf("Quitting..\n");
-    pthread_cancel(context.updateThread);
+    //Input can end before the first advertisement started the thread
+    if (!context.firstTime)
+    {
+        pthread_cancel(context.updateThread);
+    }
     display_clear();
-
-#if USE_GPIO_BITBANG_LIB
-    close(context.gpio_fd);
-#endif
+    context.transport->flush();
+    context.transport->close();
 }
 
-static int display_parseChar(const char* input)
+/**
+ * @brief Prints how many fake bcm2835 peripheral accesses were made, and how fast the latest ones were.
+ * Gaps longer than DISPLAY_FAKE_IDLE_NS are idle time between updates and aren't counted.
+ */
+static void display_printFakeStats()
 {
-    if (*input == '.' || *input == ',')
-    {
-        // Compress
-        // Adds dot to the 7seg display
+    static bcm2835_fake_access log[BCM2835_FAKE_LOG_LEN];
+    uint32_t count = bcm2835_fake_log(log, BCM2835_FAKE_LOG_LEN);
+    uint64_t busy = 0;
+    uint32_t gaps = 0;
 
-        //If the first character is dot
-        if(context.outBuffIndex == -1)
+    for (uint32_t i = 1; i < count; i++)
+    {
+        uint64_t gap = log[i].time_ns - log[i - 1].time_ns;
+        if (gap < DISPLAY_FAKE_IDLE_NS)
         {
-            context.outBuffIndex = 0;
+            busy += gap;
+            gaps++;
         }
+    }
 
-        context.outBuff.data[context.outBuffIndex] |= CHAR_DOT;
-        context.outBuffIndex++;
-        context.outBuff.len++;
-        context.dotDisplayed = true;
-        return 0;
+    printf("bcm2835 fake: %" PRIu64 " peripheral accesses\n", bcm2835_fake_access_count());
+    if (gaps > 0)
+    {
+        printf("bcm2835 fake: last %u accesses busy for %" PRIu64 " ns, %" PRIu64 " ns per access\n",
+            count, busy, busy / gaps);
     }
+}
 
-    //else
-
-    if(context.dotDisplayed == false)
-    {
-        context.outBuffIndex++;
-        context.outBuff.len++;
-    }
-    context.dotDisplayed = false;
-
-    switch (*input)
-    {
-        case '0': context.outBuff.data[context.outBuffIndex] = CHAR_ZERO; break;
-        case '1': context.outBuff.data[context.outBuffIndex] = CHAR_ONE; break;
-        case '2': context.outBuff.data[context.outBuffIndex] = CHAR_TWO; break;
-        case '3': context.outBuff.data[context.outBuffIndex] = CHAR_THREE; break;
-        case '4': context.outBuff.data[context.outBuffIndex] = CHAR_FOUR; break;
-        case '5': context.outBuff.data[context.outBuffIndex] = CHAR_FIVE; break;
-        case '6': context.outBuff.data[context.outBuffIndex] = CHAR_SIX; break;
-        case '7': context.outBuff.data[context.outBuffIndex] = CHAR_SEVEN; break;
-        case '8': context.outBuff.data[context.outBuffIndex] = CHAR_EIGHT; break;
-        case '9': context.outBuff.data[context.outBuffIndex] = CHAR_NINE; break;
-
-        case 'A': context.outBuff.data[context.outBuffIndex] = CHAR_A; break;
-        case 'a': context.outBuff.data[context.outBuffIndex] = CHAR_A; break;
-        case 'B': context.outBuff.data[context.outBuffIndex] = CHAR_B_UPPER; break;
-        case 'b': context.outBuff.data[context.outBuffIndex] = CHAR_B_LOWER; break;
-        case 'C': context.outBuff.data[context.outBuffIndex] = CHAR_C_UPPER; break;
-        case 'c': context.outBuff.data[context.outBuffIndex] = CHAR_C_LOWER; break;
-        case 'D': context.outBuff.data[context.outBuffIndex] = CHAR_D; break;
-        case 'd': context.outBuff.data[context.outBuffIndex] = CHAR_D; break;
-        case 'E': context.outBuff.data[context.outBuffIndex] = CHAR_E; break;
-        case 'e': context.outBuff.data[context.outBuffIndex] = CHAR_E; break;
-        case 'F': context.outBuff.data[context.outBuffIndex] = CHAR_F; break;
-        case 'f': context.outBuff.data[context.outBuffIndex] = CHAR_F; break;
-        case 'G': context.outBuff.data[context.outBuffIndex] = CHAR_G_UPPER; break;
-        case 'g': context.outBuff.data[context.outBuffIndex] = CHAR_G_LOWER; break;
-        case 'H': context.outBuff.data[context.outBuffIndex] = CHAR_H_UPPER; break;
-        case 'h': context.outBuff.data[context.outBuffIndex] = CHAR_H_LOWER; break;
-        case 'I': context.outBuff.data[context.outBuffIndex] = CHAR_I_UPPER; break;
-        case 'i': context.outBuff.data[context.outBuffIndex] = CHAR_I_LOWER; break;
-        case 'J': context.outBuff.data[context.outBuffIndex] = CHAR_J_UPPER; break;
-        case 'j': context.outBuff.data[context.outBuffIndex] = CHAR_J_LOWER; break;
-        case 'L': context.outBuff.data[context.outBuffIndex] = CHAR_L_UPPER; break;
-        case 'l': context.outBuff.data[context.outBuffIndex] = CHAR_L_LOWER; break;
-        case 'N': context.outBuff.data[context.outBuffIndex] = CHAR_N_UPPER; break;
-        case 'n': context.outBuff.data[context.outBuffIndex] = CHAR_N_LOWER; break;
-        case 'O': context.outBuff.data[context.outBuffIndex] = CHAR_O_UPPER; break;
-        case 'o': context.outBuff.data[context.outBuffIndex] = CHAR_O_LOWER; break;
-        case 'P': context.outBuff.data[context.outBuffIndex] = CHAR_P; break;
-        case 'p': context.outBuff.data[context.outBuffIndex] = CHAR_P; break;
-        case 'Q': context.outBuff.data[context.outBuffIndex] = CHAR_Q; break;
-        case 'q': context.outBuff.data[context.outBuffIndex] = CHAR_Q; break;
-        case 'R': context.outBuff.data[context.outBuffIndex] = CHAR_R; break;
-        case 'r': context.outBuff.data[context.outBuffIndex] = CHAR_R; break;
-        case 'S': context.outBuff.data[context.outBuffIndex] = CHAR_S; break;
-        case 's': context.outBuff.data[context.outBuffIndex] = CHAR_S; break;
-        case 'T': context.outBuff.data[context.outBuffIndex] = CHAR_T; break;
-        case 't': context.outBuff.data[context.outBuffIndex] = CHAR_T; break;
-        case 'U': context.outBuff.data[context.outBuffIndex] = CHAR_U_UPPER; break;
-        case 'u': context.outBuff.data[context.outBuffIndex] = CHAR_U_LOWER; break;
-        case 'Y': context.outBuff.data[context.outBuffIndex] = CHAR_Y; break;
-        case 'y': context.outBuff.data[context.outBuffIndex] = CHAR_Y; break;
-
-        case ' ': context.outBuff.data[context.outBuffIndex] = CHAR_SPACE; break;
-        case '-': context.outBuff.data[context.outBuffIndex] = CHAR_MINUS; break;
-        case '_': context.outBuff.data[context.outBuffIndex] = CHAR_LOW_LINE; break;
-        case '\"': context.outBuff.data[context.outBuffIndex] = CHAR_QUOTATION_MARK; break;
-        case '\'': context.outBuff.data[context.outBuffIndex] = CHAR_APOSTROPHE; break;
-        case '=': context.outBuff.data[context.outBuffIndex] = CHAR_EQUAL_SIGN; break;
-
-        default: context.outBuff.data[context.outBuffIndex] = CHAR_EMPTY; return -1;
+/** @brief Wakes the update thread up, for content or control changes */
+static void display_wake()
+{
+    // Taking the lock orders the wakeup after the update thread's check
+    pthread_mutex_lock(&context.wakeLock);
+    pthread_cond_signal(&context.wakeCond);
+    pthread_mutex_unlock(&context.wakeLock);
+}
+
+static void display_wakeUnlock(void* lock)
+{
+    pthread_mutex_unlock(lock);
+}
+
+/**
+ * @brief Hands the encoded message in cache entry `index` over to the update thread, with one atomic swap.
+ * The entry that comes back, the replaced message or the one the update thread stopped showing,
+ * can be encoded into again.
+ */
+static void display_publish(int index)
+{
+    int previous = atomic_exchange_explicit(&context.pendingBuff, index | DISPLAY_BUFF_FRESH, memory_order_acq_rel);
+
+    // The input thread outran the display, the previous message was never shown
+    context.messagesPublished++;
+    if (previous & DISPLAY_BUFF_FRESH)
+    {
+        context.messagesReplaced++;
     }
-    return 0;
+    previous &= ~DISPLAY_BUFF_FRESH;
+    context.heldBuffs[1] = context.heldBuffs[0] == previous ? context.heldBuffs[1] : context.heldBuffs[0];
+    context.heldBuffs[0] = index;
+    display_wake();
 }
 
-static void *display_updateDigits(void* parm)
+static int64_t display_nsec(const struct timespec* ts)
 {
-    //init check
-    while (1)
+    return ts->tv_sec * DISPLAY_NS_PER_SEC + ts->tv_nsec;
+}
+
+static struct timespec display_timespec(int64_t nsec)
+{
+    struct timespec ts = {
+        .tv_sec = nsec / DISPLAY_NS_PER_SEC,
+        .tv_nsec = nsec % DISPLAY_NS_PER_SEC
+    };
+    return ts;
+}
+
+/**
+ * @brief Accounts a frame that started `late` ns after its deadline,
+ * a frame shown early, after a wakeup that didn't rebase the deadline, counts as on time
+ * @retval number of whole periods missed
+ */
+static int64_t display_accountFrame(int64_t late)
+{
+    if (late < 0)
     {
-        uint8_t* digitRunner = context.outBuff.firstDisplayed;
-        
-        display_spi_write(REG_DIGIT_7, *digitRunner);
+        late = 0;
+    }
+    int64_t missed = late / context.framePeriodNs;
 
-        circular_buffer_advance(&context.outBuff, &digitRunner);
-        display_spi_write(REG_DIGIT_6, *digitRunner);
+    atomic_fetch_add_explicit(&context.framesShown, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&context.deadlinesMissed, missed, memory_order_relaxed);
+    atomic_fetch_add_explicit(&context.latenessTotalNs, late, memory_order_relaxed);
+    if (late > (int64_t)atomic_load_explicit(&context.latenessMaxNs, memory_order_relaxed))
+    {
+        atomic_store_explicit(&context.latenessMaxNs, late, memory_order_relaxed);
+    }
+    return missed;
+}
 
-        circular_buffer_advance(&context.outBuff, &digitRunner);
-        display_spi_write(REG_DIGIT_5, *digitRunner);
+/**
+ * @brief Tells if the update thread has to wake before its deadline: for a new message,
+ * a switch to or from the ticker, or glyphs fed to a ticker that stands still
+ */
+static bool display_hasNews(bool ticker, bool isStatic)
+{
+    if (atomic_load_explicit(&context.pendingBuff, memory_order_acquire) & DISPLAY_BUFF_FRESH)
+    {
+        return true;
+    }
+    if (atomic_load_explicit(&context.tickerMode, memory_order_acquire) != ticker)
+    {
+        return true;
+    }
+    return ticker && isStatic && ticker_pending(&context.ticker);
+}
 
-        circular_buffer_advance(&context.outBuff, &digitRunner);
-        display_spi_write(REG_DIGIT_4, *digitRunner);
+/**
+ * @brief Sleeps until the next scroll deadline or new content, whichever comes first.
+ * @param deadline absolute CLOCK_MONOTONIC deadline, NULL for static content, only new content wakes it
+ * @param ticker tells if the ticker is shown
+ */
+static void display_waitNext(const int64_t* deadline, bool ticker)
+{
+    struct timespec next;
+    if (deadline != NULL)
+    {
+        next = display_timespec(*deadline);
+    }
 
-        circular_buffer_advance(&context.outBuff, &digitRunner);
-        display_spi_write(REG_DIGIT_3, *digitRunner);
+    pthread_mutex_lock(&context.wakeLock);
+    pthread_cleanup_push(display_wakeUnlock, &context.wakeLock);
+    while (!display_hasNews(ticker, deadline == NULL))
+    {
+        if (deadline == NULL)
+        {
+            pthread_cond_wait(&context.wakeCond, &context.wakeLock);
+        }
+        else if (pthread_cond_timedwait(&context.wakeCond, &context.wakeLock, &next) == ETIMEDOUT)
+        {
+            break;
+        }
+    }
+    pthread_cleanup_pop(1);
+}
 
-        circular_buffer_advance(&context.outBuff, &digitRunner);
-        display_spi_write(REG_DIGIT_2, *digitRunner);
+static void *display_updateDigits(void* parm)
+{
+    int frontBuff = 0;
+    bool ticker = false;
+    bool wasStatic = false;
+    uint8_t tickerFrame[TRANSPORT_FRAME_LEN * TRANSPORT_MAX_CHIPS];
+    struct timespec now;
 
-        circular_buffer_advance(&context.outBuff, &digitRunner);
-        display_spi_write(REG_DIGIT_1, *digitRunner);
+    // Deadlines are absolute, so the bus time doesn't add up into drift
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    int64_t deadline = display_nsec(&now);
 
-        circular_buffer_advance(&context.outBuff, &digitRunner);
-        display_spi_write(REG_DIGIT_0, *digitRunner);
+    //init check
+    while (1)
+    {
+        // A new message replaces the front buffer only between frames, and starts right away
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (atomic_load_explicit(&context.pendingBuff, memory_order_acquire) & DISPLAY_BUFF_FRESH)
+        {
+            frontBuff = atomic_exchange_explicit(&context.pendingBuff, frontBuff, memory_order_acq_rel) & ~DISPLAY_BUFF_FRESH;
+            // A cached message may have been shown before, it starts from its first frame again
+            message_cache_buffer(&context.cache, frontBuff)->frameIndex = 0;
+            wasStatic = true;
+        }
+        if (atomic_load_explicit(&context.tickerMode, memory_order_acquire) != ticker)
+        {
+            ticker = !ticker;
+            wasStatic = true;
+        }
+        // Content that stood still starts scrolling now, not at its old deadline
+        if (wasStatic)
+        {
+            deadline = display_nsec(&now);
+        }
+        struct CircularBuffer* front = message_cache_buffer(&context.cache, frontBuff);
 
+        // Frames whose deadline already passed are skipped, the scroll keeps its speed
+        int64_t missed = display_accountFrame(display_nsec(&now) - deadline);
+        for (int64_t i = 0; i < missed; i++)
+        {
+            if (ticker)
+            {
+                ticker_advance(&context.ticker);
+            }
+            else
+            {
+                circular_buffer_next_frame(front);
+            }
+        }
+        deadline += missed * context.framePeriodNs;
 
-        circular_buffer_advance(&context.outBuff, &context.outBuff.firstDisplayed);
+        // Frames are compiled with the message, leftmost digit first,
+        // the ticker's window is copied out of the ring and scrolls only while glyphs are fed
+        if (ticker)
+        {
+            ticker_frame(&context.ticker, tickerFrame);
+            display_spi_write_frame(tickerFrame);
+            wasStatic = !ticker_advance(&context.ticker);
+        }
+        else
+        {
+            display_spi_write_frame(circular_buffer_frame(front));
+            circular_buffer_next_frame(front);
+            wasStatic = front->frameCount == 1;
+        }
 
-        //printf(".");
-        usleep(500000);
-        //sleep(1);
+        deadline += context.framePeriodNs;
+        display_waitNext(wasStatic ? NULL : &deadline, ticker);
     }
 }
 
+/** @brief Prints the scroll rate and how well the update thread keeps it */
+static void display_printScrollStats()
+{
+    uint64_t frames = atomic_load_explicit(&context.framesShown, memory_order_relaxed);
+    uint64_t total = atomic_load_explicit(&context.latenessTotalNs, memory_order_relaxed);
+
+    printf("scroll: %" PRIu64 " frames every %lld ms, %" PRIu64 " deadlines missed, lateness avg %" PRIu64 " us, max %" PRIu64 " us\n",
+        frames,
+        (long long)(context.framePeriodNs / DISPLAY_NS_PER_MS),
+        atomic_load_explicit(&context.deadlinesMissed, memory_order_relaxed),
+        frames > 0 ? total / frames / 1000 : 0,
+        atomic_load_explicit(&context.latenessMaxNs, memory_order_relaxed) / 1000);
+    printf("messages: %" PRIu64 " published, %" PRIu64 " replaced before they were shown, %" PRIu64 " ticker lines waited for room\n",
+        context.messagesPublished,
+        context.messagesReplaced,
+        context.tickerWaits);
+}
+
 static void display_initUpdateThread()
 {   
     int status = pthread_create(&context.updateThread, NULL, display_updateDigits, NULL);
@@ -354,6 +520,93 @@ static void display_initUpdateThread()
         printf("pthread_detach success\n");
 }
 
+/**
+ * @brief Finds the input in the message cache, or encodes it into the least recently used entry
+ * @retval index of the entry that holds the encoded message
+ */
+static int display_encode()
+{
+    uint64_t hash = message_cache_hash(context.userInput);
+    int index = message_cache_find(&context.cache, context.userInput, hash);
+
+    if (index >= 0)
+    {
+        bool held = false;
+        for (int i = 0; i < DISPLAY_BUFF_HELD; i++)
+        {
+            held = held || context.heldBuffs[i] == index;
+        }
+        if (!held)
+        {
+            return index;
+        }
+        // The update thread still holds it and writes its frame index, it can't be handed over twice
+        // or copied, the message is encoded again into an entry that takes over the key
+        message_cache_forget(&context.cache, index);
+    }
+
+    // Encodes the message into a free entry, the update thread keeps showing the old one
+    // Dots and commas are folded into the digit before them
+    index = message_cache_claim(&context.cache, context.userInput, hash, context.heldBuffs, DISPLAY_BUFF_HELD);
+    struct CircularBuffer* buff = message_cache_buffer(&context.cache, index);
+    circular_buffer_init(buff);
+    buff->len = glyph_encode_bulk(context.userInput, strlen(context.userInput), buff->data);
+    circular_buffer_compile(buff, context.digitCount);
+    return index;
+}
+
+/** @brief Starts the update thread with the first content */
+static void display_startUpdates()
+{
+    if (context.firstTime == true)
+    {
+        display_initUpdateThread();
+    }
+    context.firstTime = false;
+}
+
+/**
+ * @brief Appends the input line to the ticker, followed by a blank digit.
+ * Never waits, a line that doesn't fit in the ring is dropped and counted as an overrun.
+ * With DISPLAY_TICKER_WAIT=1 it waits for the update thread to scroll glyphs off instead,
+ * so a fast feed is slowed down to the scroll rate rather than losing text.
+ */
+static void display_feedTicker()
+{
+    uint8_t glyphs[DISPLAY_MAX_STR_LEN + 1];
+    uint32_t len = glyph_encode_bulk(context.userInput, strlen(context.userInput), glyphs);
+    glyphs[len++] = CHAR_EMPTY;
+
+    display_startUpdates();
+    if (!context.tickerWait)
+    {
+        if (ticker_push(&context.ticker, glyphs, len))
+        {
+            display_wake();
+        }
+        return;
+    }
+    bool waited = false;
+    for (uint32_t sent = 0; sent < len; )
+    {
+        uint32_t appended = ticker_append(&context.ticker, &glyphs[sent], len - sent);
+        if (appended > 0)
+        {
+            display_wake();
+        }
+        else
+        {
+            delay(context.framePeriodNs / DISPLAY_NS_PER_MS);
+            waited = true;
+        }
+        sent += appended;
+    }
+    if (waited)
+    {
+        context.tickerWaits++;
+    }
+}
+
 int display_advertisement()
 {
     // Prepares the input buffer for incoming data
@@ -365,60 +618,115 @@ int display_advertisement()
     // User input, fgets waits
     printf("Input advertisement text: ");
     fflush(stdin);
-    fgets(context.userInput, DISPLAY_MAX_STR_LEN, stdin);
-    context.userInput[strlen(context.userInput)-1] = '\0';
+    //A closed input, like the end of a piped feed, is the same as the exit command
+    bool inputClosed = fgets(context.userInput, DISPLAY_MAX_STR_LEN, stdin) == NULL;
+    //The last line of a feed, or one that didn't fit, has no newline
+    context.userInput[strcspn(context.userInput, "\n")] = '\0';
 
     //printf("Exit command check\n");
     //Exit if command is issued
-    if (strcmp(context.userInput, context.exitCommand) == 0)
+    if (inputClosed || strcmp(context.userInput, context.exitCommand) == 0)
     {
         //printf("Exit command issued\n");
         delay(10);
         display_destroy();
         return -DISPLAY_EXIT_CODE;
     }
+    //Trace commands don't change the advertisement
+    if (strcmp(context.userInput, context.traceOnCommand) == 0)
+    {
+        trace_enable(true);
+        return 0;
+    }
+    if (strcmp(context.userInput, context.traceOffCommand) == 0)
+    {
+        trace_enable(false);
+        return 0;
+    }
+    if (strcmp(context.userInput, context.traceDumpCommand) == 0)
+    {
+        trace_dump(stdout);
+        return 0;
+    }
+    //The ticker keeps its glyphs and the display its content while switching
+    if (strcmp(context.userInput, context.tickerOnCommand) == 0)
+    {
+        atomic_store_explicit(&context.tickerMode, true, memory_order_release);
+        display_wake();
+        return 0;
+    }
+    if (strcmp(context.userInput, context.tickerOffCommand) == 0)
+    {
+        atomic_store_explicit(&context.tickerMode, false, memory_order_release);
+        display_wake();
+        return 0;
+    }
+    if (strcmp(context.userInput, context.benchCommand) == 0)
+    {
+        glyph_benchmark(stdout);
+        return 0;
+    }
+    if (strcmp(context.userInput, context.refreshCommand) == 0)
+    {
+        display_refresh();
+        return 0;
+    }
+    if (strcmp(context.userInput, context.statsCommand) == 0)
+    {
+        transport_print_stats(context.transport, stdout);
+        display_printScrollStats();
+        message_cache_print_stats(&context.cache, stdout);
+        ticker_print_stats(&context.ticker, stdout);
+        if (context.fakePeripherals)
+        {
+            display_printFakeStats();
+        }
+        return 0;
+    }
     //printf("Regular display command issued\n");
-    // Prepares the display and output buffer
-    display_clear();
-    context.outBuffIndex = -1;
-    context.dotDisplayed = false;
-    circular_buffer_init(&context.outBuff);
-    for (int i = 0; i < strlen(context.userInput); i++)
+    if (atomic_load_explicit(&context.tickerMode, memory_order_relaxed))
     {
-        display_parseChar(&context.userInput[i]);
+        display_feedTicker();
+        return 0;
     }
+    display_publish(display_encode());
 
     //Turns on the advertisement if not turned on
-    if(context.firstTime == true)
-    {
-        display_initUpdateThread();
-    }
-    context.firstTime = false;
+    display_startUpdates();
 
     return 0;
 }
 
 void display_printTest()
 {
-    display_spi_write(REG_DIGIT_7, CHAR_ONE | CHAR_DOT);
-    display_spi_write(REG_DIGIT_6, CHAR_TWO |CHAR_DOT);
-    display_spi_write(REG_DIGIT_5, CHAR_THREE |CHAR_DOT);
-    display_spi_write(REG_DIGIT_4, CHAR_FOUR |CHAR_DOT);
-    display_spi_write(REG_DIGIT_3, CHAR_FIVE |CHAR_DOT);
-    display_spi_write(REG_DIGIT_2, CHAR_SIX |CHAR_DOT);
-    display_spi_write(REG_DIGIT_1, CHAR_SEVEN |CHAR_DOT);
-    display_spi_write(REG_DIGIT_0, CHAR_EIGHT |CHAR_DOT);
+    const uint8_t test[TRANSPORT_FRAME_LEN] = {
+        CHAR_ONE | CHAR_DOT,
+        CHAR_TWO | CHAR_DOT,
+        CHAR_THREE | CHAR_DOT,
+        CHAR_FOUR | CHAR_DOT,
+        CHAR_FIVE | CHAR_DOT,
+        CHAR_SIX | CHAR_DOT,
+        CHAR_SEVEN | CHAR_DOT,
+        CHAR_EIGHT | CHAR_DOT
+    };
+    uint8_t digits[TRANSPORT_FRAME_LEN * TRANSPORT_MAX_CHIPS];
+
+    // Every display in the chain shows the same test
+    for (int i = 0; i < context.digitCount; i++)
+    {
+        digits[i] = test[i % TRANSPORT_FRAME_LEN];
+    }
+    display_spi_write_frame(digits);
+}
+
+void display_refresh()
+{
+    transport_refresh(context.transport);
 }
 
 void display_clear()
 {
-    display_spi_write(REG_DIGIT_0, CHAR_EMPTY);
-    display_spi_write(REG_DIGIT_1, CHAR_EMPTY);
-    display_spi_write(REG_DIGIT_2, CHAR_EMPTY);
-    display_spi_write(REG_DIGIT_3, CHAR_EMPTY);
-    display_spi_write(REG_DIGIT_4, CHAR_EMPTY);
-    display_spi_write(REG_DIGIT_5, CHAR_EMPTY);
-    display_spi_write(REG_DIGIT_6, CHAR_EMPTY);
-    display_spi_write(REG_DIGIT_7, CHAR_EMPTY);
+    const uint8_t digits[TRANSPORT_FRAME_LEN * TRANSPORT_MAX_CHIPS] = {CHAR_EMPTY};
+    display_spi_write_frame(digits);
     //printf("Display cleared\n");
 }
@@ -13,10 +13,12 @@
  *             DIN - SPI0 MOSI (PIN 19)
  *              CS - SPI0 CE0 (PIN 24)
  *             CLK - SPI0 SCLK (PIN 23)
+ *  DOUT, optional - SPI0 MISO (PIN 21), the bus speed is tuned through it
  * 
  *________GPIO pins for bitbang________
  *
  *             DIN - GPIO 17 (PIN 11)
+ *  DIN, lanes 1-7 - GPIO 23, 24, 25, 5, 6, 12, 13
  *         CS/LOAD - GPIO 27 (PIN 13)
  *             CLK - GPIO 22 (PIN 15)
  * 
@@ -32,9 +34,21 @@
 /**
  * @brief Initializes the display
  * 
+ * @param transportName Backend to use ("spi", "spidev", "gpio_bitbang", "bcm_bitbang", "gpiochip",
+ * or "sim", which is never probed), or NULL to probe every backend and keep the fastest one
+ * 
+ * @note DISPLAY_CHAIN_LEN environment variable sets the number of daisy-chained
+ * displays (DOUT -> DIN), 1 by default. The display wired to the Pi shows the leftmost digits.
+ * DISPLAY_LANES sets the number of such chains, each with its own DIN pin, sharing CLK and LOAD
+ * (bitbang transports only), 1 by default. Lane 0 shows the leftmost digits.
+ * DISPLAY_FAKE_PERI=1 runs the bcm2835 transports on a fake peripheral block, off the Pi.
+ * DISPLAY_SCROLL_MS sets the time between two scroll frames, 500 by default.
+ * DISPLAY_TICKER_WAIT=1 makes ticker lines that don't fit wait for the scroll, instead of being dropped.
+ * DISPLAY_SPIDEV_HZ sets the spidev bus speed, 1000000 by default, at most 10000000.
+ * 
  * @retval 0 on success or an error code
 */
-int display_init();
+int display_init(const char* transportName);
 
 /**
  * @brief Deinitializes the display, stops the advertisment
@@ -46,6 +60,8 @@ void display_destroy();
 
 /** @brief Requests string input through console, and displays it, as a scrolling advertisement. 
  *  If an advertisement is already displayed, replaces the current one.
+ *  After "ticker on", input lines are appended to a ticker that scrolls them once,
+ *  so a feed of any length can be streamed, until "ticker off".
  * 
  *  @retval 0 on success, -DISPLAY_EXIT_CODE on user exit command
 */
@@ -54,6 +70,12 @@ int display_advertisement();
 /** @brief Displays "1.2.3.4.5.6.7.8." */
 void display_printTest();
 
+/** 
+ * @brief Resends every register to the display.
+ * Registers are otherwise only sent when their value changes.
+*/
+void display_refresh();
+
 /** @brief Clears the display. Doesn't stop the advertisement. */
 void display_clear();
 
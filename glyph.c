@@ -0,0 +1,341 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
+#include "glyph.h"
+#include "max7219_types.h"
+
+/** @brief Characters encoded per benchmark pass, and number of passes */
+#define GLYPH_BENCH_LEN (1 << 20)
+#define GLYPH_BENCH_ROUNDS 32
+
+// Designated initializers leave every other byte CHAR_EMPTY
+const uint8_t glyph_table[256] = {
+    ['0'] = CHAR_ZERO,
+    ['1'] = CHAR_ONE,
+    ['2'] = CHAR_TWO,
+    ['3'] = CHAR_THREE,
+    ['4'] = CHAR_FOUR,
+    ['5'] = CHAR_FIVE,
+    ['6'] = CHAR_SIX,
+    ['7'] = CHAR_SEVEN,
+    ['8'] = CHAR_EIGHT,
+    ['9'] = CHAR_NINE,
+
+    ['A'] = CHAR_A,
+    ['a'] = CHAR_A,
+    ['B'] = CHAR_B_UPPER,
+    ['b'] = CHAR_B_LOWER,
+    ['C'] = CHAR_C_UPPER,
+    ['c'] = CHAR_C_LOWER,
+    ['D'] = CHAR_D,
+    ['d'] = CHAR_D,
+    ['E'] = CHAR_E,
+    ['e'] = CHAR_E,
+    ['F'] = CHAR_F,
+    ['f'] = CHAR_F,
+    ['G'] = CHAR_G_UPPER,
+    ['g'] = CHAR_G_LOWER,
+    ['H'] = CHAR_H_UPPER,
+    ['h'] = CHAR_H_LOWER,
+    ['I'] = CHAR_I_UPPER,
+    ['i'] = CHAR_I_LOWER,
+    ['J'] = CHAR_J_UPPER,
+    ['j'] = CHAR_J_LOWER,
+    ['K'] = CHAR_K,
+    ['k'] = CHAR_K,
+    ['L'] = CHAR_L_UPPER,
+    ['l'] = CHAR_L_LOWER,
+    ['M'] = CHAR_M,
+    ['m'] = CHAR_M,
+    ['N'] = CHAR_N_UPPER,
+    ['n'] = CHAR_N_LOWER,
+    ['O'] = CHAR_O_UPPER,
+    ['o'] = CHAR_O_LOWER,
+    ['P'] = CHAR_P,
+    ['p'] = CHAR_P,
+    ['Q'] = CHAR_Q,
+    ['q'] = CHAR_Q,
+    ['R'] = CHAR_R,
+    ['r'] = CHAR_R,
+    ['S'] = CHAR_S,
+    ['s'] = CHAR_S,
+    ['T'] = CHAR_T,
+    ['t'] = CHAR_T,
+    ['U'] = CHAR_U_UPPER,
+    ['u'] = CHAR_U_LOWER,
+    ['V'] = CHAR_V,
+    ['v'] = CHAR_V,
+    ['W'] = CHAR_W,
+    ['w'] = CHAR_W,
+    ['X'] = CHAR_X,
+    ['x'] = CHAR_X,
+    ['Y'] = CHAR_Y,
+    ['y'] = CHAR_Y,
+    ['Z'] = CHAR_Z,
+    ['z'] = CHAR_Z,
+
+    [' '] = CHAR_SPACE,
+    ['.'] = CHAR_DOT,
+    [','] = CHAR_COMMA,
+    ['-'] = CHAR_MINUS,
+    ['_'] = CHAR_LOW_LINE,
+    ['"'] = CHAR_QUOTATION_MARK,
+    ['\''] = CHAR_APOSTROPHE,
+    ['='] = CHAR_EQUAL_SIGN,
+    ['!'] = CHAR_EXCLAMATION_MARK,
+    ['?'] = CHAR_QUESTION_MARK,
+    ['#'] = CHAR_NUMBER_SIGN,
+    ['$'] = CHAR_DOLLAR_SIGN,
+    ['%'] = CHAR_PERCENT_SIGN,
+    ['&'] = CHAR_AMPERSAND,
+    ['*'] = CHAR_ASTERISK,
+    ['+'] = CHAR_PLUS_SIGN,
+    ['/'] = CHAR_SLASH,
+    ['\\'] = CHAR_BACKSLASH,
+    [':'] = CHAR_COLON,
+    [';'] = CHAR_SEMICOLON,
+    ['<'] = CHAR_LESS_THAN,
+    ['>'] = CHAR_GREATER_THAN,
+    ['@'] = CHAR_AT_SIGN,
+    ['('] = CHAR_LEFT_BRACKET,
+    ['['] = CHAR_LEFT_BRACKET,
+    ['{'] = CHAR_LEFT_BRACKET,
+    [')'] = CHAR_RIGHT_BRACKET,
+    [']'] = CHAR_RIGHT_BRACKET,
+    ['}'] = CHAR_RIGHT_BRACKET,
+    ['^'] = CHAR_CIRCUMFLEX,
+    ['`'] = CHAR_GRAVE_ACCENT,
+    ['|'] = CHAR_VERTICAL_BAR,
+    ['~'] = CHAR_TILDE
+};
+
+/** @brief Tells if a character is folded into the previous digit's DP segment */
+static inline int glyph_isDot(char c)
+{
+    return c == '.' || c == ',';
+}
+
+/** @brief Tells if the dot at `i` folds into the digit before it */
+static inline int glyph_folds(const char* text, size_t i)
+{
+    return glyph_isDot(text[i]) && i > 0 && !glyph_isDot(text[i - 1]);
+}
+
+/** @brief Digit of the character at `i`, with the DP segment of a dot that follows it */
+static inline uint8_t glyph_digit(const char* text, size_t len, size_t i)
+{
+    uint8_t digit = glyph_encode(text[i]);
+    if (i + 1 < len && glyph_folds(text, i + 1))
+    {
+        digit |= CHAR_DOT;
+    }
+    return digit;
+}
+
+size_t glyph_encode_scalar(const char* text, size_t len, uint8_t* out)
+{
+    size_t n = 0;
+
+    for (size_t i = 0; i < len; i++)
+    {
+        if (!glyph_folds(text, i))
+        {
+            out[n++] = glyph_digit(text, len, i);
+        }
+    }
+    return n;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+/**
+ * @brief Shuffle that packs the kept bytes of 8 to the front, for every keep mask.
+ * Built once, at the first bulk encode.
+ */
+static uint8_t glyph_compact[256][8];
+static uint8_t glyph_keepCount[256];
+static pthread_once_t glyph_compactOnce = PTHREAD_ONCE_INIT;
+
+static void glyph_buildCompact()
+{
+    for (int mask = 0; mask < 256; mask++)
+    {
+        int n = 0;
+        for (int lane = 0; lane < 8; lane++)
+        {
+            if (mask & (1 << lane))
+            {
+                glyph_compact[mask][n++] = lane;
+            }
+        }
+        glyph_keepCount[mask] = n;
+        // Lanes after the kept ones are stored but overwritten by the next block
+        while (n < 8)
+        {
+            glyph_compact[mask][n++] = 0;
+        }
+    }
+}
+
+/** @brief Glyphs of 16 bytes, printable ASCII is six 16-entry pshufb tables picked by the high nibble */
+__attribute__((target("ssse3")))
+static inline __m128i glyph_lookupSsse3(__m128i c, const __m128i* tables)
+{
+    __m128i high = _mm_and_si128(c, _mm_set1_epi8((char)0xF0));
+    __m128i g = _mm_setzero_si128();
+
+    for (int t = 0; t < 6; t++)
+    {
+        __m128i hit = _mm_cmpeq_epi8(high, _mm_set1_epi8((char)(0x20 + 16 * t)));
+        g = _mm_or_si128(g, _mm_and_si128(hit, _mm_shuffle_epi8(tables[t], c)));
+    }
+    return g;
+}
+
+__attribute__((target("ssse3")))
+static inline __m128i glyph_isDotSsse3(__m128i c)
+{
+    return _mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8('.')), _mm_cmpeq_epi8(c, _mm_set1_epi8(',')));
+}
+
+/** @brief Encodes the 16 characters at text[i], needs text[i - 1] and text[i + 16] */
+__attribute__((target("ssse3")))
+static inline size_t glyph_blockSsse3(const char* text, size_t i, uint8_t* out, const __m128i* tables)
+{
+    __m128i cur = _mm_loadu_si128((const __m128i*)(text + i));
+    __m128i prevDot = glyph_isDotSsse3(_mm_loadu_si128((const __m128i*)(text + i - 1)));
+    __m128i curDot = glyph_isDotSsse3(cur);
+    __m128i nextDot = glyph_isDotSsse3(_mm_loadu_si128((const __m128i*)(text + i + 1)));
+
+    // A dot after a non-dot folds, its DP goes to the lane before it
+    __m128i fold = _mm_andnot_si128(prevDot, curDot);
+    __m128i foldNext = _mm_andnot_si128(curDot, nextDot);
+    __m128i digits = _mm_or_si128(glyph_lookupSsse3(cur, tables), _mm_and_si128(foldNext, _mm_set1_epi8((char)CHAR_DOT)));
+
+    // Each half is packed with its own 8-lane shuffle
+    unsigned keep = ~_mm_movemask_epi8(fold) & 0xFFFF;
+    uint8_t low = keep & 0xFF;
+    uint8_t high = keep >> 8;
+    __m128i packedLow = _mm_shuffle_epi8(digits, _mm_loadl_epi64((const __m128i*)glyph_compact[low]));
+    __m128i packedHigh = _mm_shuffle_epi8(_mm_srli_si128(digits, 8), _mm_loadl_epi64((const __m128i*)glyph_compact[high]));
+
+    _mm_storel_epi64((__m128i*)out, packedLow);
+    _mm_storel_epi64((__m128i*)(out + glyph_keepCount[low]), packedHigh);
+    return glyph_keepCount[low] + glyph_keepCount[high];
+}
+
+__attribute__((target("ssse3")))
+static size_t glyph_encodeSsse3(const char* text, size_t len, uint8_t* out)
+{
+    __m128i tables[6];
+    size_t n = 0;
+    size_t i;
+
+    pthread_once(&glyph_compactOnce, glyph_buildCompact);
+    for (int t = 0; t < 6; t++)
+    {
+        tables[t] = _mm_loadu_si128((const __m128i*)&glyph_table[0x20 + 16 * t]);
+    }
+
+    // The first character has no previous one to load
+    if (len > 0 && !glyph_folds(text, 0))
+    {
+        out[n++] = glyph_digit(text, len, 0);
+    }
+    for (i = 1; i + 17 <= len; i += 16)
+    {
+        n += glyph_blockSsse3(text, i, out + n, tables);
+    }
+    for (; i < len; i++)
+    {
+        if (!glyph_folds(text, i))
+        {
+            out[n++] = glyph_digit(text, len, i);
+        }
+    }
+    return n;
+}
+
+const char* glyph_simd_name()
+{
+    return __builtin_cpu_supports("ssse3") ? "ssse3" : "scalar";
+}
+
+size_t glyph_encode_bulk(const char* text, size_t len, uint8_t* out)
+{
+    // pshufb isn't in the x86-64 baseline
+    if (__builtin_cpu_supports("ssse3"))
+    {
+        return glyph_encodeSsse3(text, len, out);
+    }
+    return glyph_encode_scalar(text, len, out);
+}
+
+#else
+
+const char* glyph_simd_name()
+{
+    return "scalar";
+}
+
+size_t glyph_encode_bulk(const char* text, size_t len, uint8_t* out)
+{
+    return glyph_encode_scalar(text, len, out);
+}
+#endif
+
+/** @brief Nanoseconds `encode` takes for `rounds` passes over the text */
+static int64_t glyph_time(size_t (*encode)(const char*, size_t, uint8_t*),
+    const char* text, size_t len, uint8_t* out, int rounds, size_t* digits)
+{
+    struct timespec start, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int r = 0; r < rounds; r++)
+    {
+        *digits = encode(text, len, out);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (int64_t)(end.tv_sec - start.tv_sec) * 1000000000LL + (end.tv_nsec - start.tv_nsec);
+}
+
+void glyph_benchmark(FILE* out)
+{
+    char* text = malloc(GLYPH_BENCH_LEN);
+    uint8_t* scalarOut = malloc(GLYPH_BENCH_LEN);
+    uint8_t* bulkOut = malloc(GLYPH_BENCH_LEN);
+    size_t scalarDigits, bulkDigits;
+
+    if (text == NULL || scalarOut == NULL || bulkOut == NULL)
+    {
+        fprintf(out, "glyph benchmark: out of memory\n");
+        free(text);
+        free(scalarOut);
+        free(bulkOut);
+        return;
+    }
+
+    // Printable ASCII with runs of dots, so every folding case shows up
+    uint32_t seed = 1;
+    for (size_t i = 0; i < GLYPH_BENCH_LEN; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        text[i] = (seed >> 16) % 4 == 0 ? '.' : ' ' + (seed >> 16) % 95;
+    }
+
+    int64_t scalarNs = glyph_time(glyph_encode_scalar, text, GLYPH_BENCH_LEN, scalarOut, GLYPH_BENCH_ROUNDS, &scalarDigits);
+    int64_t bulkNs = glyph_time(glyph_encode_bulk, text, GLYPH_BENCH_LEN, bulkOut, GLYPH_BENCH_ROUNDS, &bulkDigits);
+    bool match = scalarDigits == bulkDigits && memcmp(scalarOut, bulkOut, scalarDigits) == 0;
+
+    fprintf(out, "glyph scalar: %.1f MB/s\n", (double)GLYPH_BENCH_LEN * GLYPH_BENCH_ROUNDS * 1000 / scalarNs);
+    fprintf(out, "glyph %s: %.1f MB/s, %s\n", glyph_simd_name(),
+        (double)GLYPH_BENCH_LEN * GLYPH_BENCH_ROUNDS * 1000 / bulkNs,
+        match ? "output matches" : "OUTPUT DIFFERS");
+
+    free(text);
+    free(scalarOut);
+    free(bulkOut);
+}
@@ -0,0 +1,47 @@
+/**
+ * @file glyph.h
+ * @brief ASCII to 7-segment glyph encoding.
+ *
+ * @note Every byte maps to a glyph through one table load, characters that
+ * can't be shown map to CHAR_EMPTY. Dots and commas map to CHAR_DOT,
+ * folding them into the previous digit is left to the caller.
+ *
+ * @authors Ognjen Jarcevic RA99/2020, Lazar Vranjes RA19/2020
+ */
+
+#ifndef GLYPH_H
+#define GLYPH_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** @brief Glyph of every byte value, built at compile time from the Character enum */
+extern const uint8_t glyph_table[256];
+
+/** @brief Encodes a single character */
+static inline uint8_t glyph_encode(char c)
+{
+    return glyph_table[(uint8_t)c];
+}
+
+/**
+ * @brief Encodes `len` characters into digits, folding every '.' or ',' into the digit before it.
+ * A dot that follows another dot, or starts the text, gets a digit of its own.
+ *
+ * @param out room for `len` digits
+ * @retval number of digits
+ * @note Uses SSSE3 table lookups where available, same output as glyph_encode_scalar
+ */
+size_t glyph_encode_bulk(const char* text, size_t len, uint8_t* out);
+
+/** @brief Reference version of glyph_encode_bulk, one character at a time */
+size_t glyph_encode_scalar(const char* text, size_t len, uint8_t* out);
+
+/** @brief Name of the vector unit glyph_encode_bulk uses, "scalar" if none */
+const char* glyph_simd_name();
+
+/** @brief Times glyph_encode_scalar against glyph_encode_bulk on a long text and checks they match */
+void glyph_benchmark(FILE* out);
+
+#endif //GLYPH_H
@@ -3,6 +3,8 @@
 #include <asm/io.h> // ioremap(), iounmap()
 #include <linux/errno.h> // ENOMEM
 #include <linux/delay.h>
+#include <linux/module.h> // module_param()
+#include <linux/irqflags.h> // local_irq_save()
 /*
 NOTE: Check Broadcom BCM8325 datasheet, page 91+
 	GPIO Base address is set to 0x7E20 0000,
@@ -161,6 +163,18 @@ void gpio__clear(uint8_t pin) {
 	iowrite32(0x1 << pin, virt_gpio_base + GPCLR0_OFFSET);
 }
 
+/**
+ * Set/clear every pin in @a mask with a single register write.
+ * Pins are not range checked, callers pass only configured output pins.
+ */
+void gpio__set_mask(uint32_t mask) {
+	iowrite32(mask, virt_gpio_base + GPSET0_OFFSET);
+}
+
+void gpio__clear_mask(uint32_t mask) {
+	iowrite32(mask, virt_gpio_base + GPCLR0_OFFSET);
+}
+
 uint8_t gpio__read(uint8_t pin) {
 	uint32_t tmp;
 	if(check_pin(pin)){
@@ -170,36 +184,126 @@ uint8_t gpio__read(uint8_t pin) {
 	return tmp>>pin & 1;
 }
 
-void gpio__spi_instruction(uint16_t bits)
+static bool fast_mode = true;
+module_param(fast_mode, bool, 0644);
+MODULE_PARM_DESC(fast_mode, "Bitbang with ndelay busy-waits instead of sleeping between edges");
+
+static uint bit_period_ns = GPIO__DEFAULT_BIT_PERIOD_NS;
+module_param(bit_period_ns, uint, 0644);
+MODULE_PARM_DESC(bit_period_ns, "Fast mode CLK period in ns, clamped to the MAX7219 minimum of 100");
+
+static const uint8_t lane_din_pins[BITBANG_MAX_LANES] = BITBANG_LANE_DIN_PINS;
+
+void gpio__steer_lanes(int lanes)
+{
+	int lane;
+
+	for (lane = 0; lane < lanes; lane++)
+	{
+		gpio__steer_pinmux(lane_din_pins[lane], GPIO__OUT);
+	}
+}
+
+/** DIN pins of every lane whose instruction @a j has bit @a i set. */
+static uint32_t gpio__lanes_bit(const uint16_t* instrs, int count, int lanes, int j, int i)
+{
+	uint32_t mask = 0;
+	int lane;
+
+	for (lane = 0; lane < lanes; lane++)
+	{
+		if (instrs[lane * count + j] & (1 << i))
+		{
+			mask |= 1 << lane_din_pins[lane];
+		}
+	}
+	return mask;
+}
+
+static void gpio__spi_frame_fast(const uint16_t* instrs, int count, int lanes)
 {
-	unsigned short mask;
+	const uint32_t clk = 1 << BITBANG_CLK_PIN;
+	const uint32_t load = 1 << BITBANG_LOAD_PIN;
+	uint32_t din = 0;
+	uint32_t ones;
+	unsigned int half_period;
+	unsigned long flags;
+	int lane;
 	int i;
+	int j;
+
+	for (lane = 0; lane < lanes; lane++)
+	{
+		din |= 1 << lane_din_pins[lane];
+	}
+
+	// ndelay() is calibrated against loops_per_jiffy, so it only ever waits longer
+	half_period = max_t(unsigned int, READ_ONCE(bit_period_ns), MAX7219_T_CP_NS) / 2;
+
+	// Whole frame is a few microseconds, don't let anything stretch a CLK pulse
+	local_irq_save(flags);
+
+	// Data is shifted in while LOAD is low
+	gpio__clear_mask(load | clk);
+
+	for (j = 0; j < count; j++)
+	{
+		for (i = 15; i >= 0; i--)
+		{
+			// Falling CLK clears DIN of every lane with a 0 bit, then the 1 bits are set
+			ones = gpio__lanes_bit(instrs, count, lanes, j, i);
+			gpio__clear_mask(clk | (din & ~ones));
+			gpio__set_mask(ones);
+			// Covers both CLK low width and DIN setup time
+			ndelay(half_period);
+
+			// Processes the bit on the rising edge
+			gpio__set_mask(clk);
+			ndelay(half_period);
+		}
+	}
+
+	// Every chip latches its last 16 bits on the rising edge
+	gpio__set_mask(load);
+	ndelay(MAX7219_T_CSW_NS);
+
+	local_irq_restore(flags);
+}
+
+static void gpio__spi_frame_slow(const uint16_t* instrs, int count, int lanes)
+{
+	int lane;
+	int i;
+	int j;
     gpio__set(BITBANG_LOAD_PIN);
     usleep_range(50,150);
 
-    for (i = 16; i > 0; i--)
+    for (j = 0; j < count; j++)
     {
-        // Calculate bitmask, MSB first, LSB last
-        mask = 1 << (i - 1); 
+        for (i = 16; i > 0; i--)
+        {
+            // Write a bit to DIN while the CLK is cleared
+            gpio__clear(BITBANG_CLK_PIN);
+            usleep_range(50,150);
 
-        // Write a bit to DIN while the CLK is cleared
-        gpio__clear(BITBANG_CLK_PIN);
-        usleep_range(50,150);
+            // Write the current data bit, MSB first, LSB last
+            for (lane = 0; lane < lanes; lane++)
+            {
+                if (instrs[lane * count + j] & (1 << (i - 1)))
+                {
+                    gpio__set(lane_din_pins[lane]);
+                }
+                else
+                {
+                    gpio__clear(lane_din_pins[lane]);
+                }
+            }
+            usleep_range(50,150);
 
-        // Write the current data bit
-        if (bits & mask)
-        {
-            gpio__set(BITBANG_DIN_PIN);
+            // Processes the bit on the rising edge
+            gpio__set(BITBANG_CLK_PIN);
+            usleep_range(50,150);
         }
-        else
-        {
-            gpio__clear(BITBANG_DIN_PIN);
-        }
-        usleep_range(50,150);
-
-        // Processes the bit on the rising edge
-        gpio__set(BITBANG_CLK_PIN);
-        usleep_range(50,150);
     }
 
     // Stops the data input
@@ -208,3 +312,25 @@ void gpio__spi_instruction(uint16_t bits)
     gpio__set(BITBANG_LOAD_PIN);
     usleep_range(50,150);
 }
+
+void gpio__spi_frame_lanes(const uint16_t* instrs, int count, int lanes)
+{
+	if (READ_ONCE(fast_mode))
+	{
+		gpio__spi_frame_fast(instrs, count, lanes);
+	}
+	else
+	{
+		gpio__spi_frame_slow(instrs, count, lanes);
+	}
+}
+
+void gpio__spi_frame(const uint16_t* instrs, int count)
+{
+	gpio__spi_frame_lanes(instrs, count, 1);
+}
+
+void gpio__spi_instruction(uint16_t bits)
+{
+	gpio__spi_frame(&bits, 1);
+}
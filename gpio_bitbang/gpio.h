@@ -13,6 +13,19 @@ void gpio__exit(void);
 #define BITBANG_LOAD_PIN 27
 #define BITBANG_CLK_PIN 22
 
+// DIN pins of displays sharing CLK and LOAD, lane 0 is BITBANG_DIN_PIN.
+#define BITBANG_MAX_LANES 8
+#define BITBANG_LANE_DIN_PINS {BITBANG_DIN_PIN, 23, 24, 25, 5, 6, 12, 13}
+
+// MAX7219 serial interface timing minimums, in ns.
+#define MAX7219_T_CP_NS 100 // CLK period
+#define MAX7219_T_CH_NS 50 // CLK pulse width, high and low
+#define MAX7219_T_DS_NS 25 // DIN setup before CLK rising edge
+#define MAX7219_T_CSW_NS 50 // LOAD pulse width high
+
+// Default bit period of the fast mode, twice the minimum for wiring margin.
+#define GPIO__DEFAULT_BIT_PERIOD_NS (2*MAX7219_T_CP_NS)
+
 typedef enum {
 	GPIO__IN = 0b000,
 	GPIO__OUT = 0b001,
@@ -33,5 +46,30 @@ void gpio__steer_pinmux(uint8_t pin, gpio__pinmux_fun_t pinmux_fun);
 void gpio__set(uint8_t pin);
 void gpio__clear(uint8_t pin);
 uint8_t gpio__read(uint8_t pin);
+void gpio__set_mask(uint32_t mask);
+void gpio__clear_mask(uint32_t mask);
+
+/**
+ * Bitbangs a single 16-bit instruction, MSB first.
+ * In fast mode (default) the instruction is a single non-sleeping burst,
+ * with the bit period set by the bit_period_ns module parameter.
+ */
 void gpio__spi_instruction(uint16_t bits);
+
+/**
+ * Bitbangs @a count instructions within a single LOAD frame, instrs[0] first.
+ * Used for daisy-chained MAX7219s, where the first instruction ends up in the farthest chip.
+ */
+void gpio__spi_frame(const uint16_t* instrs, int count);
+
+/**
+ * Bitbangs @a lanes frames of @a count instructions at once, one per lane DIN pin,
+ * sharing CLK and LOAD. Frames are stored one after another, lane 0 first.
+ * Every CLK edge sets/clears the DIN bits of all lanes with one register write each,
+ * so K lanes take as long as one.
+ */
+void gpio__spi_frame_lanes(const uint16_t* instrs, int count, int lanes);
+
+/** Configures DIN pins of the first @a lanes lanes as outputs. */
+void gpio__steer_lanes(int lanes);
 #endif // GPIO_H
@@ -0,0 +1,118 @@
+/**
+ * @file gpio_bitbang.h
+ * @brief Interface of the gpio_bitbang driver, shared by the kernel module and userspace.
+ *
+ * @note A write() carries 1 to GPIO_BITBANG_MAX_INSTR 16-bit instructions,
+ * in native byte order, register in the high byte and value in the low byte.
+ * Instructions are queued and bitbanged back-to-back by a kernel thread,
+ * in the order they are written. write() returns as soon as the whole
+ * write is queued, fsync() waits for the queue to drain and poll()
+ * reports POLLOUT while a write of GPIO_BITBANG_MAX_INSTR would not block.
+ *
+ * With GPIO_BITBANG_IOC_SET_CHAIN_LEN set to N, every N consecutive instructions
+ * are shifted out within one LOAD frame, the first one ends up in the farthest chip.
+ * Writes must then hold a multiple of N instructions.
+ *
+ * With GPIO_BITBANG_IOC_SET_LANES set to K, K chains with their own DIN pins
+ * (sharing CLK and LOAD) are shifted in parallel. A LOAD frame then holds
+ * K x N instructions, the N instructions of lane 0 first.
+ */
+
+#ifndef GPIO_BITBANG_H
+#define GPIO_BITBANG_H
+
+#ifdef __KERNEL__
+#include <linux/types.h>
+#else
+#include <stdint.h>
+#endif
+#include <linux/ioctl.h>
+
+#define GPIO_BITBANG_DEV_FN "/dev/gpio_bitbang"
+
+/** @brief Size of a single instruction, in bytes */
+#define GPIO_BITBANG_INSTR_LEN 2
+
+/** @brief Max number of instructions accepted by a single write() */
+#define GPIO_BITBANG_MAX_INSTR 64
+
+/** @brief Max number of daisy-chained MAX7219s */
+#define GPIO_BITBANG_MAX_CHAIN_LEN 8
+
+/** @brief Max number of DIN lanes sharing CLK and LOAD, see gpio.h for their pins */
+#define GPIO_BITBANG_MAX_LANES 8
+
+/** @brief Number of digit registers of a display */
+#define GPIO_BITBANG_DIGIT_COUNT 8
+
+/**
+ * @brief Framebuffer page, mmap()-ed from the device at offset 0.
+ *
+ * @note Userspace makes `seq` odd, stores the digits, then makes `seq` even again.
+ * The driver samples the page every 1/refresh_hz seconds and bitbangs only the
+ * digits that differ from what the display shows. fsync() also waits for the
+ * current framebuffer contents to reach the display.
+ */
+struct gpio_bitbang_fb
+{
+    /** @brief Sequence counter, odd while userspace is updating the digits */
+    uint32_t seq;
+    /** @brief digits[i] is the value of the MAX7219 register REG_DIGIT_0 + i */
+    uint8_t digits[GPIO_BITBANG_DIGIT_COUNT];
+};
+
+/** @brief All digits of a display, for GPIO_BITBANG_IOC_PUSH_FRAME */
+struct gpio_bitbang_frame
+{
+    /** @brief digits[i] is the value of the MAX7219 register REG_DIGIT_0 + i */
+    uint8_t digits[GPIO_BITBANG_DIGIT_COUNT];
+};
+
+/** @brief Driver counters, for GPIO_BITBANG_IOC_GET_STATS */
+struct gpio_bitbang_stats
+{
+    /** @brief Instructions bitbanged since the module was loaded */
+    uint64_t instructions;
+    /** @brief Bytes bitbanged since the module was loaded */
+    uint64_t bytes;
+    /** @brief Time spent bitbanging, in ns */
+    uint64_t busy_ns;
+    /** @brief Instructions queued but not yet bitbanged */
+    uint32_t queue_depth;
+    /** @brief Instructions the queue can hold */
+    uint32_t queue_len;
+};
+
+#define GPIO_BITBANG_IOC_MAGIC 'g'
+
+/** @brief Queues all 8 digits back-to-back, no other instruction can get in between. Single chip only. */
+#define GPIO_BITBANG_IOC_PUSH_FRAME _IOW(GPIO_BITBANG_IOC_MAGIC, 1, struct gpio_bitbang_frame)
+
+/** @brief Queue a control register write to every chained chip, the argument points to the uint8_t register value */
+#define GPIO_BITBANG_IOC_SET_INTENSITY _IOW(GPIO_BITBANG_IOC_MAGIC, 2, uint8_t)
+#define GPIO_BITBANG_IOC_SET_SCAN_LIMIT _IOW(GPIO_BITBANG_IOC_MAGIC, 3, uint8_t)
+#define GPIO_BITBANG_IOC_SET_SHUTDOWN _IOW(GPIO_BITBANG_IOC_MAGIC, 4, uint8_t)
+#define GPIO_BITBANG_IOC_SET_DECODE _IOW(GPIO_BITBANG_IOC_MAGIC, 5, uint8_t)
+
+/** @brief Reads the driver counters */
+#define GPIO_BITBANG_IOC_GET_STATS _IOR(GPIO_BITBANG_IOC_MAGIC, 6, struct gpio_bitbang_stats)
+
+/**
+ * @brief Sets the number of daisy-chained chips, the argument points to a uint8_t.
+ * Waits for the queue to drain first. The mmap framebuffer is ignored for chains.
+ */
+#define GPIO_BITBANG_IOC_SET_CHAIN_LEN _IOW(GPIO_BITBANG_IOC_MAGIC, 7, uint8_t)
+
+/**
+ * @brief Sets the number of DIN lanes bitbanged in parallel, the argument points to a uint8_t.
+ * Waits for the queue to drain first. The mmap framebuffer is ignored for lanes.
+ */
+#define GPIO_BITBANG_IOC_SET_LANES _IOW(GPIO_BITBANG_IOC_MAGIC, 8, uint8_t)
+
+/**
+ * @brief Forgets which digits the display shows, for a display that lost its state.
+ * The next framebuffer push sends every digit, even the ones that didn't change.
+ */
+#define GPIO_BITBANG_IOC_RESYNC _IO(GPIO_BITBANG_IOC_MAGIC, 9)
+
+#endif // GPIO_BITBANG_H
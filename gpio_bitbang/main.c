@@ -2,18 +2,236 @@
 #include <linux/fs.h> // file_operations
 #include <linux/errno.h> // EFAULT
 #include <linux/uaccess.h> // copy_from_user(), copy_to_user()
+#include <linux/kfifo.h>
+#include <linux/kthread.h>
+#include <linux/mutex.h>
+#include <linux/wait.h>
+#include <linux/poll.h>
+#include <linux/mm.h> // remap_pfn_range()
+#include <linux/hrtimer.h>
+#include <linux/timekeeping.h> // ktime_get_ns()
 //#include <string.h>
 #include "gpio.h"
+#include "gpio_bitbang.h"
+#include "trace.h"
 
 MODULE_LICENSE("Dual BSD/GPL");
 
 #define DEV_NAME "gpio_bitbang"
 
-#define DATA_BUFF_LEN 10
-
 #define DEV_MAJOR 260
 
-static char data_buffer[DATA_BUFF_LEN];
+// Instructions the queue can hold, must be a power of two.
+#define QUEUE_LEN 256
+
+// MAX7219 registers, see max7219_types.h.
+#define REG_DIGIT_0 0x01
+#define REG_DECODE_MODE 0x09
+#define REG_INTENSITY 0x0A
+#define REG_SCAN_LIMIT 0x0B
+#define REG_SHUTDOWN 0x0C
+
+// Bit of gpio_bitbang_dev_t.flags, set when the framebuffer should be sampled.
+#define FB_DIRTY 0
+// Bit of gpio_bitbang_dev_t.flags, set when the worker should forget pushed_digits.
+#define FB_RESYNC 1
+
+static uint refresh_hz = 100;
+module_param(refresh_hz, uint, 0444);
+MODULE_PARM_DESC(refresh_hz, "Rate at which the mmap framebuffer is pushed to the display, 0 to push only on fsync()");
+
+typedef struct {
+	// Instructions waiting to be bitbanged, one producer (under write_lock), one consumer (worker).
+	DECLARE_KFIFO(queue, uint16_t, QUEUE_LEN);
+	// Serializes writers, so that frames are enqueued whole.
+	struct mutex write_lock;
+	// Instructions enqueued but not yet on the pins, including the one being bitbanged.
+	atomic_t pending;
+	// Worker waits for instructions.
+	wait_queue_head_t work_wait;
+	// Writers, poll() and fsync() wait for the worker to make progress.
+	wait_queue_head_t progress_wait;
+	// Drains the queue to the pins.
+	struct task_struct* worker;
+	// Instructions of the write() being enqueued.
+	uint16_t write_buffer[GPIO_BITBANG_MAX_INSTR];
+	// Page shared with userspace through mmap().
+	struct gpio_bitbang_fb* fb;
+	// Sequence number of the framebuffer contents that are on the display.
+	uint32_t pushed_seq;
+	// Digits that are on the display, whichever way they were sent.
+	uint8_t pushed_digits[GPIO_BITBANG_DIGIT_COUNT];
+	// Tells if pushed_digits are known, false until every digit was sent once.
+	bool pushed_valid;
+	// FB_DIRTY, FB_RESYNC
+	unsigned long flags;
+	// Periodically marks the framebuffer dirty.
+	struct hrtimer refresh_timer;
+	// Instructions bitbanged since the module was loaded.
+	atomic64_t instructions;
+	// Time spent bitbanging them, in ns.
+	atomic64_t busy_ns;
+	// Number of daisy-chained MAX7219s on every DIN lane.
+	int chain_len;
+	// Number of DIN lanes sharing CLK and LOAD, every chain_len * lanes queued instructions share one LOAD frame.
+	int lanes;
+} gpio_bitbang_dev_t;
+
+static gpio_bitbang_dev_t dev;
+
+/** Number of instructions that share one LOAD frame. */
+static int gpio_bitbang_frame_len(void)
+{
+	return READ_ONCE(dev.chain_len) * READ_ONCE(dev.lanes);
+}
+
+/**
+ * Bitbangs @a count instructions within one LOAD frame, one per chained chip on every lane.
+ * Lane frames are stored one after another, lane 0 first.
+ */
+static void gpio_bitbang_send(const uint16_t* instrs, int count, int lanes)
+{
+	uint8_t reg = instrs[0] >> 8;
+	u64 start;
+	int i;
+
+	for (i = 0; i < count; i++)
+	{
+		trace__record(instrs[i]);
+	}
+	start = ktime_get_ns();
+	gpio__spi_frame_lanes(instrs, count / lanes, lanes);
+	atomic64_add(ktime_get_ns() - start, &dev.busy_ns);
+	atomic64_add(count, &dev.instructions);
+
+	// Keeps track of the digits, so the framebuffer push can skip them,
+	// a chain or lanes frame leaves the single chip's digits unknown
+	if (count != 1)
+	{
+		dev.pushed_valid = false;
+	}
+	else if (reg >= REG_DIGIT_0 && reg < REG_DIGIT_0 + GPIO_BITBANG_DIGIT_COUNT)
+	{
+		dev.pushed_digits[reg - REG_DIGIT_0] = instrs[0] & 0xFF;
+	}
+}
+
+/**
+ * Marks the framebuffer dirty again after a push found userspace in the middle of an update.
+ * Without the refresh timer nothing else would push it, and fsync() would wait forever.
+ */
+static void gpio_bitbang_retry_fb(void)
+{
+	if (!refresh_hz)
+	{
+		set_bit(FB_DIRTY, &dev.flags);
+		wake_up_interruptible(&dev.work_wait);
+	}
+}
+
+/**
+ * Sends the framebuffer digits that differ from the display.
+ * Leaves the framebuffer untouched if userspace is in the middle of an update,
+ * the next refresh picks it up, or a retry if there is no refresh.
+ */
+static void gpio_bitbang_push_fb(void)
+{
+	uint8_t digits[GPIO_BITBANG_DIGIT_COUNT];
+	uint16_t instr;
+	uint32_t seq;
+	int i;
+
+	// pushed_digits are only touched by the worker, the ioctl just asks for it
+	if (test_and_clear_bit(FB_RESYNC, &dev.flags))
+	{
+		dev.pushed_valid = false;
+	}
+
+	seq = smp_load_acquire(&dev.fb->seq);
+	if (seq & 1)
+	{
+		gpio_bitbang_retry_fb();
+		return;
+	}
+	if (seq == dev.pushed_seq && dev.pushed_valid)
+	{
+		return;
+	}
+
+	// The framebuffer holds a single chip, it is ignored for chains and lanes
+	if (gpio_bitbang_frame_len() != 1)
+	{
+		WRITE_ONCE(dev.pushed_seq, seq);
+		wake_up_interruptible(&dev.progress_wait);
+		return;
+	}
+	memcpy(digits, dev.fb->digits, GPIO_BITBANG_DIGIT_COUNT);
+	smp_rmb();
+	if (READ_ONCE(dev.fb->seq) != seq)
+	{
+		gpio_bitbang_retry_fb();
+		return;
+	}
+
+	for (i = 0; i < GPIO_BITBANG_DIGIT_COUNT; i++)
+	{
+		if (!dev.pushed_valid || digits[i] != dev.pushed_digits[i])
+		{
+			instr = ((uint16_t)(REG_DIGIT_0 + i) << 8) | digits[i];
+			gpio_bitbang_send(&instr, 1, 1);
+		}
+	}
+	dev.pushed_valid = true;
+	WRITE_ONCE(dev.pushed_seq, seq);
+	wake_up_interruptible(&dev.progress_wait);
+}
+
+static enum hrtimer_restart gpio_bitbang_refresh(struct hrtimer* timer)
+{
+	// Only samples the sequence number, the worker does the bitbanging
+	if (READ_ONCE(dev.fb->seq) != READ_ONCE(dev.pushed_seq))
+	{
+		set_bit(FB_DIRTY, &dev.flags);
+		wake_up_interruptible(&dev.work_wait);
+	}
+	hrtimer_forward_now(timer, ns_to_ktime(NSEC_PER_SEC / refresh_hz));
+	return HRTIMER_RESTART;
+}
+
+static int gpio_bitbang_worker(void* data)
+{
+	uint16_t frame[GPIO_BITBANG_MAX_INSTR];
+	int frame_len;
+	int lanes;
+
+	while (!kthread_should_stop())
+	{
+		wait_event_interruptible(
+			dev.work_wait,
+			!kfifo_is_empty(&dev.queue) || test_bit(FB_DIRTY, &dev.flags) || kthread_should_stop()
+		);
+
+		//writes are whole frames, so the queue always holds whole frames
+		frame_len = gpio_bitbang_frame_len();
+		lanes = READ_ONCE(dev.lanes);
+		while (kfifo_len(&dev.queue) >= frame_len)
+		{
+			kfifo_out(&dev.queue, frame, frame_len);
+			gpio_bitbang_send(frame, frame_len, lanes);
+			atomic_sub(frame_len, &dev.pending);
+			wake_up_interruptible(&dev.progress_wait);
+			cond_resched();
+		}
+
+		if (test_and_clear_bit(FB_DIRTY, &dev.flags))
+		{
+			gpio_bitbang_push_fb();
+			//a retried push lets userspace finish its update first
+			cond_resched();
+		}
+	}
+	return 0;
+}
 
 static int gpio_bitbang_open(struct inode *inode, struct file *filp)
 {
@@ -29,76 +247,374 @@ static int gpio_bitbang_release(struct inode *inode, struct file *filp)
 
 static ssize_t gpio_bitbang_read(struct file* filp, char* buf, size_t len, loff_t* f_pos)
 {
+	//dumps the instruction trace
+	return trace__read(buf, len, f_pos);
+}
+
+/**
+ * Enqueues all @a count instructions at once, waiting for the worker to make space.
+ * Must be called with write_lock held.
+ */
+static int gpio_bitbang_enqueue(const uint16_t* instrs, size_t count, bool nonblock)
+{
+	int status;
+
+	while (kfifo_avail(&dev.queue) < count)
+	{
+		if (nonblock)
+		{
+			return -EAGAIN;
+		}
+		status = wait_event_interruptible(
+			dev.progress_wait,
+			kfifo_avail(&dev.queue) >= count
+		);
+		if (status)
+		{
+			return status;
+		}
+	}
+
+	atomic_add(count, &dev.pending);
+	kfifo_in(&dev.queue, instrs, count);
+	wake_up_interruptible(&dev.work_wait);
 	return 0;
 }
 
 static ssize_t gpio_bitbang_write(struct file* filp, const char *buf, size_t len, loff_t *f_pos)
 {
-	uint16_t instr;
-	
-	memset(data_buffer, 0, DATA_BUFF_LEN);
-	
-	if (copy_from_user(data_buffer, buf, len) != 0)
+	size_t count = len / GPIO_BITBANG_INSTR_LEN;
+	int status;
+
+	//at most GPIO_BITBANG_MAX_INSTR instructions
+	if (len == 0 || count > GPIO_BITBANG_MAX_INSTR || len % GPIO_BITBANG_INSTR_LEN != 0)
+	{
+		printk(KERN_INFO "GPIO_BITBANG Driver: wrong instruction");
+		return -EINVAL;
+	}
+
+	if (mutex_lock_interruptible(&dev.write_lock))
 	{
+		return -ERESTARTSYS;
+	}
+
+	//only whole chain frames, the chain length and lanes only change under write_lock
+	if (count % gpio_bitbang_frame_len() != 0)
+	{
+		mutex_unlock(&dev.write_lock);
+		printk(KERN_INFO "GPIO_BITBANG Driver: wrong instruction");
+		return -EINVAL;
+	}
+
+	if (copy_from_user(dev.write_buffer, buf, len) != 0)
+	{
+		mutex_unlock(&dev.write_lock);
 		printk(KERN_INFO "GPIO_BITBANG Driver error reading");
 		return -EFAULT;
 	}
-    else
-    {
-		//spi instruction incoming
-		if (len == 2)
-		{
-			//printk(KERN_INFO "GPIO_BITBANG Driver: good instruction");
-			instr = ((uint16_t)data_buffer[1]<<8) | (uint16_t)data_buffer[0];
-			printk(KERN_INFO "bbb: %x|%x\n", data_buffer[1], data_buffer[0]);
-			gpio__spi_instruction(instr);
-		}
-		else
-		{
-			printk(KERN_INFO "GPIO_BITBANG Driver: wrong instruction");
-			return -1;
-		}
+
+	//the whole write is enqueued at once
+	status = gpio_bitbang_enqueue(dev.write_buffer, count, filp->f_flags & O_NONBLOCK);
+	mutex_unlock(&dev.write_lock);
+
+	return status ? status : len;
+}
+
+/** Enqueues a control register write for every chained chip, @a max is the largest valid value. */
+static long gpio_bitbang_set_register(struct file* filp, uint8_t reg, uint8_t max, uint8_t __user *arg)
+{
+	uint8_t val;
+	uint16_t instrs[GPIO_BITBANG_MAX_INSTR];
+	int status;
+	int i;
+
+	if (get_user(val, arg))
+	{
+		return -EFAULT;
+	}
+	if (val > max)
+	{
+		return -EINVAL;
 	}
 
-	return 2;
+	if (mutex_lock_interruptible(&dev.write_lock))
+	{
+		return -ERESTARTSYS;
+	}
+	for (i = 0; i < gpio_bitbang_frame_len(); i++)
+	{
+		instrs[i] = ((uint16_t)reg << 8) | val;
+	}
+	status = gpio_bitbang_enqueue(instrs, gpio_bitbang_frame_len(), filp->f_flags & O_NONBLOCK);
+	mutex_unlock(&dev.write_lock);
+	return status;
+}
+
+static long gpio_bitbang_push_frame(struct file* filp, struct gpio_bitbang_frame __user *arg)
+{
+	struct gpio_bitbang_frame frame;
+	uint16_t instrs[GPIO_BITBANG_DIGIT_COUNT];
+	int status;
+	int i;
+
+	if (copy_from_user(&frame, arg, sizeof(frame)) != 0)
+	{
+		return -EFAULT;
+	}
+	for (i = 0; i < GPIO_BITBANG_DIGIT_COUNT; i++)
+	{
+		instrs[i] = ((uint16_t)(REG_DIGIT_0 + i) << 8) | frame.digits[i];
+	}
+
+	//all 8 digits are enqueued back-to-back
+	if (mutex_lock_interruptible(&dev.write_lock))
+	{
+		return -ERESTARTSYS;
+	}
+	if (gpio_bitbang_frame_len() != 1)
+	{
+		mutex_unlock(&dev.write_lock);
+		return -EINVAL;
+	}
+	status = gpio_bitbang_enqueue(instrs, GPIO_BITBANG_DIGIT_COUNT, filp->f_flags & O_NONBLOCK);
+	mutex_unlock(&dev.write_lock);
+	return status;
+}
+
+static long gpio_bitbang_get_stats(struct gpio_bitbang_stats __user *arg)
+{
+	struct gpio_bitbang_stats stats = {
+		.instructions = atomic64_read(&dev.instructions),
+		.bytes = atomic64_read(&dev.instructions) * GPIO_BITBANG_INSTR_LEN,
+		.busy_ns = atomic64_read(&dev.busy_ns),
+		.queue_depth = atomic_read(&dev.pending),
+		.queue_len = QUEUE_LEN
+	};
+
+	if (copy_to_user(arg, &stats, sizeof(stats)) != 0)
+	{
+		return -EFAULT;
+	}
+	return 0;
+}
+
+static long gpio_bitbang_set_chain_len(uint8_t __user *arg)
+{
+	uint8_t chain_len;
+	int status;
+
+	if (get_user(chain_len, arg))
+	{
+		return -EFAULT;
+	}
+	if (chain_len < 1 || chain_len > GPIO_BITBANG_MAX_CHAIN_LEN)
+	{
+		return -EINVAL;
+	}
+
+	//frames already queued keep their length
+	if (mutex_lock_interruptible(&dev.write_lock))
+	{
+		return -ERESTARTSYS;
+	}
+	status = wait_event_interruptible(dev.progress_wait, atomic_read(&dev.pending) == 0);
+	if (!status)
+	{
+		WRITE_ONCE(dev.chain_len, chain_len);
+	}
+	mutex_unlock(&dev.write_lock);
+	return status;
+}
+
+static long gpio_bitbang_set_lanes(uint8_t __user *arg)
+{
+	uint8_t lanes;
+	int status;
+
+	if (get_user(lanes, arg))
+	{
+		return -EFAULT;
+	}
+	if (lanes < 1 || lanes > GPIO_BITBANG_MAX_LANES)
+	{
+		return -EINVAL;
+	}
+
+	//frames already queued keep their length
+	if (mutex_lock_interruptible(&dev.write_lock))
+	{
+		return -ERESTARTSYS;
+	}
+	status = wait_event_interruptible(dev.progress_wait, atomic_read(&dev.pending) == 0);
+	if (!status)
+	{
+		gpio__steer_lanes(lanes);
+		WRITE_ONCE(dev.lanes, lanes);
+	}
+	mutex_unlock(&dev.write_lock);
+	return status;
+}
+
+/** Makes the worker push every framebuffer digit again, it doesn't wait for the push. */
+static long gpio_bitbang_resync(void)
+{
+	set_bit(FB_RESYNC, &dev.flags);
+	set_bit(FB_DIRTY, &dev.flags);
+	wake_up_interruptible(&dev.work_wait);
+	return 0;
+}
+
+static long gpio_bitbang_ioctl(struct file* filp, unsigned int cmd, unsigned long arg)
+{
+	void __user *argp = (void __user *)arg;
+
+	switch (cmd)
+	{
+		case GPIO_BITBANG_IOC_PUSH_FRAME: return gpio_bitbang_push_frame(filp, argp);
+		case GPIO_BITBANG_IOC_SET_INTENSITY: return gpio_bitbang_set_register(filp, REG_INTENSITY, 0x0F, argp);
+		case GPIO_BITBANG_IOC_SET_SCAN_LIMIT: return gpio_bitbang_set_register(filp, REG_SCAN_LIMIT, 0x07, argp);
+		case GPIO_BITBANG_IOC_SET_SHUTDOWN: return gpio_bitbang_set_register(filp, REG_SHUTDOWN, 0x01, argp);
+		case GPIO_BITBANG_IOC_SET_DECODE: return gpio_bitbang_set_register(filp, REG_DECODE_MODE, 0xFF, argp);
+		case GPIO_BITBANG_IOC_GET_STATS: return gpio_bitbang_get_stats(argp);
+		case GPIO_BITBANG_IOC_SET_CHAIN_LEN: return gpio_bitbang_set_chain_len(argp);
+		case GPIO_BITBANG_IOC_SET_LANES: return gpio_bitbang_set_lanes(argp);
+		case GPIO_BITBANG_IOC_RESYNC: return gpio_bitbang_resync();
+		default: return -ENOTTY;
+	}
+}
+
+static int gpio_bitbang_fsync(struct file* filp, loff_t start, loff_t end, int datasync)
+{
+	uint32_t seq = smp_load_acquire(&dev.fb->seq);
+
+	//pushes the framebuffer now instead of on the next refresh
+	set_bit(FB_DIRTY, &dev.flags);
+	wake_up_interruptible(&dev.work_wait);
+
+	//waits until every enqueued instruction and the framebuffer are on the pins,
+	//a newer framebuffer pushed meanwhile holds the digits of this one too
+	return wait_event_interruptible(
+		dev.progress_wait,
+		atomic_read(&dev.pending) == 0 && ((seq & 1) || (int32_t)(READ_ONCE(dev.pushed_seq) - seq) >= 0)
+	);
+}
+
+static int gpio_bitbang_mmap(struct file* filp, struct vm_area_struct* vma)
+{
+	//only the framebuffer page can be mapped
+	if (vma->vm_pgoff != 0 || vma->vm_end - vma->vm_start > PAGE_SIZE)
+	{
+		return -EINVAL;
+	}
+	return remap_pfn_range(
+		vma,
+		vma->vm_start,
+		virt_to_phys(dev.fb) >> PAGE_SHIFT,
+		vma->vm_end - vma->vm_start,
+		vma->vm_page_prot
+	);
+}
+
+static __poll_t gpio_bitbang_poll(struct file* filp, struct poll_table_struct* wait)
+{
+	poll_wait(filp, &dev.progress_wait, wait);
+
+	//writable when a write of any size won't block
+	if (kfifo_avail(&dev.queue) >= GPIO_BITBANG_MAX_INSTR)
+	{
+		return EPOLLOUT | EPOLLWRNORM;
+	}
+	return 0;
 }
 
 static struct file_operations gpio_bitbang_fops = {
+	//open and mapped files pin the module, rmmod would free a mapped framebuffer
+	.owner = THIS_MODULE,
 	.open = gpio_bitbang_open,
 	.release = gpio_bitbang_release,
 	.read  = gpio_bitbang_read,
-	.write = gpio_bitbang_write
+	.write = gpio_bitbang_write,
+	.fsync = gpio_bitbang_fsync,
+	.poll = gpio_bitbang_poll,
+	.mmap = gpio_bitbang_mmap,
+	.unlocked_ioctl = gpio_bitbang_ioctl
 };
 
+static void gpio_bitbang_free_fb(void)
+{
+	ClearPageReserved(virt_to_page(dev.fb));
+	free_page((unsigned long)dev.fb);
+	dev.fb = NULL;
+}
+
 int gpio_bitbang_init(void)
 {
-    int status = register_chrdev(DEV_MAJOR, DEV_NAME, &gpio_bitbang_fops);
-	if(status < 0)
-    {
-		printk(KERN_INFO DEV_NAME": cannot obtain major number %d!\n", DEV_MAJOR);
-		return status;
+	int status;
+
+	INIT_KFIFO(dev.queue);
+	mutex_init(&dev.write_lock);
+	atomic_set(&dev.pending, 0);
+	atomic64_set(&dev.instructions, 0);
+	atomic64_set(&dev.busy_ns, 0);
+	dev.chain_len = 1;
+	dev.lanes = 1;
+	init_waitqueue_head(&dev.work_wait);
+	init_waitqueue_head(&dev.progress_wait);
+
+	dev.fb = (struct gpio_bitbang_fb*)get_zeroed_page(GFP_KERNEL);
+	if(!dev.fb){
+		return -ENOMEM;
 	}
+	SetPageReserved(virt_to_page(dev.fb));
 
     status = gpio__init();
 	if(status){
 		printk(KERN_INFO DEV_NAME": gpio__init() failed!\n");
-		unregister_chrdev(DEV_MAJOR, DEV_NAME);
+		gpio_bitbang_free_fb();
+		return status;
 	}
-    else
-    {
-        printk(KERN_INFO DEV_NAME": Inserting module successful.\n");
-    }
 	gpio__steer_pinmux(BITBANG_CLK_PIN, GPIO__OUT);
 	gpio__steer_pinmux(BITBANG_DIN_PIN, GPIO__OUT);
 	gpio__steer_pinmux(BITBANG_LOAD_PIN, GPIO__OUT);
-    return status;
+
+	dev.worker = kthread_run(gpio_bitbang_worker, NULL, DEV_NAME);
+	if(IS_ERR(dev.worker)){
+		printk(KERN_INFO DEV_NAME": cannot start worker thread!\n");
+		gpio__exit();
+		gpio_bitbang_free_fb();
+		return PTR_ERR(dev.worker);
+	}
+
+    status = register_chrdev(DEV_MAJOR, DEV_NAME, &gpio_bitbang_fops);
+	if(status < 0)
+    {
+		printk(KERN_INFO DEV_NAME": cannot obtain major number %d!\n", DEV_MAJOR);
+		kthread_stop(dev.worker);
+		gpio__exit();
+		gpio_bitbang_free_fb();
+		return status;
+	}
+
+	if(refresh_hz){
+		hrtimer_init(&dev.refresh_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+		dev.refresh_timer.function = gpio_bitbang_refresh;
+		hrtimer_start(&dev.refresh_timer, ns_to_ktime(NSEC_PER_SEC / refresh_hz), HRTIMER_MODE_REL);
+	}
+
+    printk(KERN_INFO DEV_NAME": Inserting module successful.\n");
+    return 0;
 }
 
 void gpio_bitbang_exit(void)
 {
     printk(KERN_INFO DEV_NAME": Removing %s module\n", DEV_NAME);
-    gpio__exit();
     unregister_chrdev(DEV_MAJOR, DEV_NAME);
+    if(refresh_hz){
+        hrtimer_cancel(&dev.refresh_timer);
+    }
+    kthread_stop(dev.worker);
+    gpio__exit();
+    gpio_bitbang_free_fb();
 }
 
 module_init(gpio_bitbang_init);
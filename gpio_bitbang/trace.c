@@ -0,0 +1,94 @@
+#include "trace.h"
+
+#include <linux/module.h> // module_param()
+#include <linux/atomic.h>
+#include <linux/timekeeping.h> // ktime_get_ns()
+#include <linux/uaccess.h> // copy_to_user()
+#include <linux/errno.h> // EFAULT
+
+static bool trace_enable;
+module_param(trace_enable, bool, 0644);
+MODULE_PARM_DESC(trace_enable, "Record every instruction into the trace ring, read it from the device");
+
+typedef struct {
+	uint32_t seq; // index of the record + 1, 0 while being written
+	u64 timestamp; // ktime_get_ns()
+	uint16_t instr;
+} trace_record_t;
+
+static trace_record_t trace_ring[TRACE__LEN];
+
+// Index of the next record to be written.
+static atomic_t trace_head = ATOMIC_INIT(0);
+
+// Longest formatted record: 20 digit timestamp, " xx|xx\n" and a terminator.
+#define TRACE_LINE_LEN 32
+
+void trace__record(uint16_t instr)
+{
+	uint32_t index;
+	trace_record_t* r;
+
+	if(!READ_ONCE(trace_enable)){
+		return;
+	}
+
+	// Every writer claims its own slot, no locks needed
+	index = (uint32_t)atomic_inc_return(&trace_head) - 1;
+	r = &trace_ring[index & (TRACE__LEN - 1)];
+
+	WRITE_ONCE(r->seq, 0);
+	smp_wmb();
+	r->timestamp = ktime_get_ns();
+	r->instr = instr;
+	smp_wmb();
+	WRITE_ONCE(r->seq, index + 1);
+}
+
+ssize_t trace__read(char __user *buf, size_t len, loff_t *f_pos)
+{
+	char line[TRACE_LINE_LEN];
+	uint32_t end = (uint32_t)atomic_read(&trace_head);
+	uint32_t start = end > TRACE__LEN ? end - TRACE__LEN : 0;
+	uint32_t index;
+	uint32_t seq;
+	u64 timestamp;
+	uint16_t instr;
+	trace_record_t* r;
+	size_t copied = 0;
+	int line_len;
+
+	// Overwritten records are skipped
+	index = *f_pos < start ? start : (uint32_t)*f_pos;
+
+	for (; index < end; index++)
+	{
+		r = &trace_ring[index & (TRACE__LEN - 1)];
+
+		seq = READ_ONCE(r->seq);
+		smp_rmb();
+		timestamp = r->timestamp;
+		instr = r->instr;
+		smp_rmb();
+
+		// Record is being written or was overwritten meanwhile
+		if (seq != index + 1 || READ_ONCE(r->seq) != seq)
+		{
+			continue;
+		}
+
+		line_len = snprintf(line, TRACE_LINE_LEN, "%llu %02x|%02x\n", timestamp, instr >> 8, instr & 0xFF);
+		if (copied + line_len > len)
+		{
+			break;
+		}
+		if (copy_to_user(buf + copied, line, line_len) != 0)
+		{
+			return -EFAULT;
+		}
+		copied += line_len;
+	}
+
+	*f_pos = index;
+	return copied;
+}
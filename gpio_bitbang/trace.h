@@ -0,0 +1,24 @@
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <linux/types.h>
+
+/**
+ * Number of records kept in the trace ring, must be a power of two.
+ * When the ring is full, the oldest records are overwritten.
+ */
+#define TRACE__LEN 1024
+
+/**
+ * Records a single instruction, if the trace_enable module parameter is set.
+ * Lock-free, safe to call from any context.
+ */
+void trace__record(uint16_t instr);
+
+/**
+ * Formats records still in the ring into the user buffer, oldest first.
+ * @a f_pos holds the index of the next record to be read.
+ */
+ssize_t trace__read(char __user *buf, size_t len, loff_t *f_pos);
+#endif // TRACE_H
@@ -1,9 +1,11 @@
 #include "display.h"
+#include "glyph.h"
 #include <stdio.h>
 
-int main(void)
+int main(int argc, char** argv)
 {
-    int status = display_init();
+    // Optional argument selects the transport, otherwise the fastest one is probed
+    int status = display_init(argc > 1 ? argv[1] : NULL);
     if(status != 0)
     {
         printf("display_init failed\n");
@@ -12,6 +14,11 @@ int main(void)
     display_clear();
     //display_printTest();
     printf("type \"exit\" to quit the program\n");
+    printf("type \"trace on\", \"trace off\" or \"trace\" to record and print sent instructions\n");
+    printf("type \"stats\" to print transport counters\n");
+    printf("type \"refresh\" to resend every register to the display\n");
+    printf("type \"ticker on\" to append every line to a streaming ticker, \"ticker off\" to go back\n");
+    printf("type \"bench\" to benchmark the %s glyph encoder\n", glyph_simd_name());
     while(status == 0)
     {  
         status = display_advertisement();
@@ -63,8 +63,10 @@ typedef enum Character
     CHAR_I_LOWER = (0x50),
     CHAR_J_UPPER = (0x78),
     CHAR_J_LOWER = (0x58),
+    CHAR_K = (0x57),
     CHAR_L_UPPER = (0x0E),
     CHAR_L_LOWER = (0x06),
+    CHAR_M = (0x54),
     CHAR_N_UPPER = (0x76),
     CHAR_N_LOWER = (0x15),
     CHAR_O_UPPER = (0x7E),
@@ -76,7 +78,11 @@ typedef enum Character
     CHAR_T = (0x0F),
     CHAR_U_UPPER = (0x3E),
     CHAR_U_LOWER = (0x1C),
+    CHAR_V = (0x1C),
+    CHAR_W = (0x2A),
+    CHAR_X = (0x37),
     CHAR_Y = (0x33),
+    CHAR_Z = (0x6D),
 
     CHAR_EMPTY = (0x00),
     CHAR_SPACE = (0x00),
@@ -87,7 +93,28 @@ typedef enum Character
     CHAR_LOW_LINE = (0x08),
     CHAR_QUOTATION_MARK =(0x22),
     CHAR_APOSTROPHE = (0x02),
-    CHAR_EQUAL_SIGN = (0x09)
+    CHAR_EQUAL_SIGN = (0x09),
+    CHAR_EXCLAMATION_MARK = (0xA0),
+    CHAR_QUESTION_MARK = (0x65),
+    CHAR_NUMBER_SIGN = (0x49),
+    CHAR_DOLLAR_SIGN = (0x5B),
+    CHAR_PERCENT_SIGN = (0x25),
+    CHAR_AMPERSAND = (0x6F),
+    CHAR_ASTERISK = (0x63),
+    CHAR_PLUS_SIGN = (0x31),
+    CHAR_SLASH = (0x25),
+    CHAR_BACKSLASH = (0x13),
+    CHAR_COLON = (0x48),
+    CHAR_SEMICOLON = (0x88),
+    CHAR_LESS_THAN = (0x0D),
+    CHAR_GREATER_THAN = (0x19),
+    CHAR_AT_SIGN = (0x7D),
+    CHAR_LEFT_BRACKET = (0x4E),
+    CHAR_RIGHT_BRACKET = (0x78),
+    CHAR_CIRCUMFLEX = (0x62),
+    CHAR_GRAVE_ACCENT = (0x02),
+    CHAR_VERTICAL_BAR = (0x06),
+    CHAR_TILDE = (0x40)
 } Character;
 
 /**
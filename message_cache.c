@@ -0,0 +1,125 @@
+#include "message_cache.h"
+#include <string.h>
+#include <inttypes.h>
+
+#define MESSAGE_CACHE_FNV_OFFSET 0xcbf29ce484222325ULL
+#define MESSAGE_CACHE_FNV_PRIME 0x100000001b3ULL
+
+void message_cache_init(struct MessageCache* cache)
+{
+    for (int i = 0; i < MESSAGE_CACHE_LEN; i++)
+    {
+        cache->entries[i].valid = false;
+        cache->entries[i].lastUsed = 0;
+        circular_buffer_init(&cache->entries[i].buff);
+    }
+    cache->clock = 0;
+    cache->hits = 0;
+    cache->misses = 0;
+    cache->evictions = 0;
+}
+
+uint64_t message_cache_hash(const char* text)
+{
+    uint64_t hash = MESSAGE_CACHE_FNV_OFFSET;
+
+    for (const char* c = text; *c != '\0'; c++)
+    {
+        hash = (hash ^ (uint8_t)*c) * MESSAGE_CACHE_FNV_PRIME;
+    }
+    return hash;
+}
+
+int message_cache_find(struct MessageCache* cache, const char* text, uint64_t hash)
+{
+    cache->clock++;
+    for (int i = 0; i < MESSAGE_CACHE_LEN; i++)
+    {
+        struct MessageCacheEntry* e = &cache->entries[i];
+
+        // The text is only compared when the hashes match
+        if (e->valid && e->hash == hash && strcmp(e->text, text) == 0)
+        {
+            e->lastUsed = cache->clock;
+            cache->hits++;
+            return i;
+        }
+    }
+    cache->misses++;
+    return -1;
+}
+
+static bool message_cache_isBusy(int index, const int* busy, int busyCount)
+{
+    for (int i = 0; i < busyCount; i++)
+    {
+        if (busy[i] == index)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/** @brief Least recently used entry that isn't busy, entries without a message come first */
+static int message_cache_victim(const struct MessageCache* cache, const int* busy, int busyCount)
+{
+    int victim = -1;
+
+    for (int i = 0; i < MESSAGE_CACHE_LEN; i++)
+    {
+        const struct MessageCacheEntry* e = &cache->entries[i];
+
+        if (message_cache_isBusy(i, busy, busyCount))
+        {
+            continue;
+        }
+        if (!e->valid)
+        {
+            return i;
+        }
+        if (victim < 0 || e->lastUsed < cache->entries[victim].lastUsed)
+        {
+            victim = i;
+        }
+    }
+    return victim;
+}
+
+int message_cache_claim(struct MessageCache* cache, const char* text, uint64_t hash, const int* busy, int busyCount)
+{
+    int index = message_cache_victim(cache, busy, busyCount);
+    struct MessageCacheEntry* e = &cache->entries[index];
+
+    if (e->valid)
+    {
+        cache->evictions++;
+    }
+    e->valid = true;
+    e->hash = hash;
+    e->lastUsed = cache->clock;
+    strncpy(e->text, text, MESSAGE_CACHE_TEXT_LEN - 1);
+    e->text[MESSAGE_CACHE_TEXT_LEN - 1] = '\0';
+    return index;
+}
+
+void message_cache_forget(struct MessageCache* cache, int index)
+{
+    cache->entries[index].valid = false;
+    cache->hits--;
+    cache->misses++;
+}
+
+struct CircularBuffer* message_cache_buffer(struct MessageCache* cache, int index)
+{
+    return &cache->entries[index].buff;
+}
+
+void message_cache_print_stats(const struct MessageCache* cache, FILE* out)
+{
+    fprintf(out, "message cache: %" PRIu64 " hits, %" PRIu64 " misses, %" PRIu64 " evictions, %d entries\n",
+        cache->hits,
+        cache->misses,
+        cache->evictions,
+        MESSAGE_CACHE_LEN);
+}
@@ -0,0 +1,86 @@
+/**
+ * @file message_cache.h
+ * @brief LRU cache of encoded messages, keyed by a hash of their text.
+ *
+ * @note Every entry holds a message's digits and its compiled scroll frames,
+ * so showing a cached message again needs no encoding or compiling.
+ * Entries are also the buffers handed over to the update thread, by index.
+ * The cache is only used from the input thread, the caller tells which
+ * entries the update thread holds, they are never evicted.
+ *
+ * @authors Ognjen Jarcevic RA99/2020, Lazar Vranjes RA19/2020
+ */
+
+#ifndef MESSAGE_CACHE_H
+#define MESSAGE_CACHE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "circular_buffer.h"
+
+/** @brief Number of entries, enough for a few dozen advertisements and the ones being shown */
+#define MESSAGE_CACHE_LEN 64
+
+/** @brief Longest text kept as a key, with the terminating zero */
+#define MESSAGE_CACHE_TEXT_LEN 128
+
+struct MessageCacheEntry
+{
+    /** @brief Tells if the entry holds a message, entries that don't are evicted first */
+    bool valid;
+    /** @brief Hash of `text`, compared before the text itself */
+    uint64_t hash;
+    /** @brief Time of the last use, in lookups since the cache was initialized */
+    uint64_t lastUsed;
+    /** @brief Text the message was encoded from */
+    char text[MESSAGE_CACHE_TEXT_LEN];
+    /** @brief Encoded message and its scroll frames */
+    struct CircularBuffer buff;
+};
+
+struct MessageCache
+{
+    struct MessageCacheEntry entries[MESSAGE_CACHE_LEN];
+    /** @brief Counts lookups, for the LRU order */
+    uint64_t clock;
+    /** @brief Lookups that found the message, lookups that didn't, and messages evicted */
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+};
+
+/** @brief Empties the cache, every entry holds an empty message */
+void message_cache_init(struct MessageCache* cache);
+
+/** @brief FNV-1a hash of the text */
+uint64_t message_cache_hash(const char* text);
+
+/**
+ * @brief Looks the text up and marks it as used
+ * @retval index of its entry, or -1 if it isn't cached
+ */
+int message_cache_find(struct MessageCache* cache, const char* text, uint64_t hash);
+
+/**
+ * @brief Takes the least recently used entry, except the `busyCount` entries in `busy`,
+ * and keys it with the text. The caller encodes the message into its buffer.
+ * @retval index of the entry
+ */
+int message_cache_claim(struct MessageCache* cache, const char* text, uint64_t hash, const int* busy, int busyCount);
+
+/**
+ * @brief Drops the message of an entry that message_cache_find just returned,
+ * only its key is touched, not its buffer. The entry is evicted first once it isn't busy.
+ * The find is counted as a miss instead of a hit, the caller encodes the message again.
+ */
+void message_cache_forget(struct MessageCache* cache, int index);
+
+/** @brief Buffer of an entry */
+struct CircularBuffer* message_cache_buffer(struct MessageCache* cache, int index);
+
+/** @brief Prints the hit, miss and eviction counters */
+void message_cache_print_stats(const struct MessageCache* cache, FILE* out);
+
+
+#endif //MESSAGE_CACHE_H
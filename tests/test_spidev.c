@@ -0,0 +1,150 @@
+/**
+ * @file test_spidev.c
+ * @brief Checks the SPI_IOC_MESSAGE transfers the spidev transport sends, without a device.
+ *
+ * @note Build and run from the repository root:
+ * gcc -I. -o test_spidev tests/test_spidev.c transport_spidev.c && ./test_spidev
+ *
+ * @authors Ognjen Jarcevic RA99/2020, Lazar Vranjes RA19/2020
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <linux/spi/spidev.h>
+#include "transport.h"
+#include "max7219_types.h"
+
+#define TEST_MAX_MESSAGES 4
+#define TEST_MAX_BYTES (2 * TRANSPORT_MAX_CHAIN_LEN)
+#define TEST_DIGIT_COUNT 8
+
+/** @brief One recorded SPI_IOC_MESSAGE, the transfers and their tx bytes */
+struct Message
+{
+    int count;
+    struct spi_ioc_transfer transfers[TRANSPORT_REG_COUNT];
+    uint8_t tx[TRANSPORT_REG_COUNT][TEST_MAX_BYTES];
+};
+
+static struct Message recorded[TEST_MAX_MESSAGES];
+static int recordedCount;
+static int failures;
+
+#define CHECK(cond) \
+    do \
+    { \
+        if (!(cond)) \
+        { \
+            printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+static int record_ioctl(int fd, unsigned long request, void* arg)
+{
+    (void)fd;
+    if (_IOC_TYPE(request) != SPI_IOC_MAGIC || _IOC_NR(request) != 0 || recordedCount == TEST_MAX_MESSAGES)
+    {
+        return -1;
+    }
+
+    struct Message* m = &recorded[recordedCount++];
+    m->count = _IOC_SIZE(request) / sizeof(struct spi_ioc_transfer);
+    memcpy(m->transfers, arg, m->count * sizeof(struct spi_ioc_transfer));
+    for (int i = 0; i < m->count; i++)
+    {
+        memcpy(m->tx[i], (const void*)(uintptr_t)m->transfers[i].tx_buf, m->transfers[i].len);
+    }
+    return 0;
+}
+
+/** @brief Checks that a message holds `instrs` as one 2 byte CS frame each */
+static void check_frames(const struct Message* m, const uint16_t* instrs, int count)
+{
+    CHECK(m->count == count);
+    for (int i = 0; i < m->count && i < count; i++)
+    {
+        CHECK(m->transfers[i].len == 2);
+        CHECK(m->tx[i][0] == instrs[i] >> 8);
+        CHECK(m->tx[i][1] == (instrs[i] & 0xFF));
+        // CS toggles between instructions, it's released after the last one anyway
+        CHECK(m->transfers[i].cs_change == (i < count - 1));
+    }
+}
+
+static void test_frame(void)
+{
+    uint16_t instrs[TEST_DIGIT_COUNT];
+
+    for (int i = 0; i < TEST_DIGIT_COUNT; i++)
+    {
+        instrs[i] = TRANSPORT_INSTR(REG_DIGIT_0 + i, 0x30 + i);
+    }
+    recordedCount = 0;
+    transport_spidev.write_batch(instrs, TEST_DIGIT_COUNT);
+
+    // A whole frame is one syscall
+    CHECK(recordedCount == 1);
+    check_frames(&recorded[0], instrs, TEST_DIGIT_COUNT);
+}
+
+static void test_long_batch(void)
+{
+    uint16_t instrs[TRANSPORT_REG_COUNT + 3];
+    int count = sizeof(instrs) / sizeof(instrs[0]);
+
+    for (int i = 0; i < count; i++)
+    {
+        instrs[i] = TRANSPORT_INSTR(REG_DIGIT_0 + i % TEST_DIGIT_COUNT, i);
+    }
+    recordedCount = 0;
+    transport_spidev.write_batch(instrs, count);
+
+    CHECK(recordedCount == 2);
+    check_frames(&recorded[0], instrs, TRANSPORT_REG_COUNT);
+    check_frames(&recorded[1], instrs + TRANSPORT_REG_COUNT, count - TRANSPORT_REG_COUNT);
+}
+
+static void test_chain_frame(void)
+{
+    const int chainLen = 3;
+    uint16_t instrs[3];
+
+    for (int chip = 0; chip < chainLen; chip++)
+    {
+        instrs[chip] = TRANSPORT_INSTR(REG_DIGIT_0, 0x10 * (chip + 1));
+    }
+    recordedCount = 0;
+    transport_spidev.write_chain(instrs, chainLen, 1);
+
+    // One CS frame shifts an instruction into every chip, the farthest one's goes first
+    CHECK(recordedCount == 1);
+    CHECK(recorded[0].count == 1);
+    CHECK(recorded[0].transfers[0].len == (uint32_t)(2 * chainLen));
+    CHECK(recorded[0].transfers[0].cs_change == 0);
+    for (int chip = 0; chip < chainLen; chip++)
+    {
+        int offset = (chainLen - 1 - chip) * 2;
+        CHECK(recorded[0].tx[0][offset] == instrs[chip] >> 8);
+        CHECK(recorded[0].tx[0][offset + 1] == (instrs[chip] & 0xFF));
+    }
+}
+
+int main(void)
+{
+    transport_spidev_ioctl = record_ioctl;
+
+    test_frame();
+    test_long_batch();
+    test_chain_frame();
+
+    if (failures > 0)
+    {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("spidev tests passed\n");
+    return 0;
+}
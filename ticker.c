@@ -0,0 +1,143 @@
+#include "ticker.h"
+#include <string.h>
+#include <inttypes.h>
+#include "max7219_types.h"
+
+#define TICKER_MASK (TICKER_RING_LEN - 1)
+
+_Static_assert((TICKER_RING_LEN & TICKER_MASK) == 0, "ticker positions are masked, the length must be a power of two");
+
+void ticker_init(struct Ticker* t, uint32_t frameLen)
+{
+    memset(t->glyphs, CHAR_EMPTY, sizeof(t->glyphs));
+    t->frameLen = frameLen;
+    t->tailCache = 0;
+    t->headCache = frameLen;
+    atomic_store_explicit(&t->appended, 0, memory_order_relaxed);
+    atomic_store_explicit(&t->overruns, 0, memory_order_relaxed);
+    atomic_store_explicit(&t->dropped, 0, memory_order_relaxed);
+
+    // The blank window counts as appended, it scrolls off as the first glyphs come in
+    atomic_store_explicit(&t->tail, 0, memory_order_relaxed);
+    atomic_store_explicit(&t->head, frameLen, memory_order_release);
+}
+
+/**
+ * @brief Number of glyphs that can be appended, reloads the consumer's tail only
+ * if the cached one leaves less than `wanted`
+ */
+static uint32_t ticker_room(struct Ticker* t, uint32_t head, uint32_t wanted)
+{
+    uint32_t room = TICKER_RING_LEN - (head - t->tailCache);
+
+    if (room < wanted)
+    {
+        // Acquire pairs with the consumer's release, it is done reading the reclaimed glyphs
+        t->tailCache = atomic_load_explicit(&t->tail, memory_order_acquire);
+        room = TICKER_RING_LEN - (head - t->tailCache);
+    }
+    return room;
+}
+
+/** @brief Copies `count` glyphs in at `head` and publishes them */
+static void ticker_store(struct Ticker* t, uint32_t head, const uint8_t* glyphs, uint32_t count)
+{
+    uint32_t first = head & TICKER_MASK;
+    uint32_t split = TICKER_RING_LEN - first;
+
+    if (split >= count)
+    {
+        memcpy(&t->glyphs[first], glyphs, count);
+    }
+    else
+    {
+        memcpy(&t->glyphs[first], glyphs, split);
+        memcpy(t->glyphs, glyphs + split, count - split);
+    }
+
+    // Release publishes the glyphs before the new head
+    atomic_store_explicit(&t->head, head + count, memory_order_release);
+    atomic_fetch_add_explicit(&t->appended, count, memory_order_relaxed);
+}
+
+uint32_t ticker_append(struct Ticker* t, const uint8_t* glyphs, uint32_t count)
+{
+    uint32_t head = atomic_load_explicit(&t->head, memory_order_relaxed);
+    uint32_t room = ticker_room(t, head, count);
+
+    if (count > room)
+    {
+        count = room;
+    }
+    ticker_store(t, head, glyphs, count);
+    return count;
+}
+
+bool ticker_push(struct Ticker* t, const uint8_t* glyphs, uint32_t count)
+{
+    uint32_t head = atomic_load_explicit(&t->head, memory_order_relaxed);
+
+    if (ticker_room(t, head, count) < count)
+    {
+        atomic_fetch_add_explicit(&t->overruns, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&t->dropped, count, memory_order_relaxed);
+        return false;
+    }
+    ticker_store(t, head, glyphs, count);
+    return true;
+}
+
+bool ticker_pending(struct Ticker* t)
+{
+    uint32_t tail = atomic_load_explicit(&t->tail, memory_order_relaxed);
+
+    if (t->headCache - tail > t->frameLen)
+    {
+        return true;
+    }
+    // Acquire pairs with the producer's release, the new glyphs are visible
+    t->headCache = atomic_load_explicit(&t->head, memory_order_acquire);
+    return t->headCache - tail > t->frameLen;
+}
+
+void ticker_frame(const struct Ticker* t, uint8_t* frame)
+{
+    uint32_t tail = atomic_load_explicit(&t->tail, memory_order_relaxed);
+    uint32_t first = tail & TICKER_MASK;
+    uint32_t split = TICKER_RING_LEN - first;
+
+    // The window is at most two runs, before and after the end of the ring
+    if (split >= t->frameLen)
+    {
+        memcpy(frame, &t->glyphs[first], t->frameLen);
+        return;
+    }
+    memcpy(frame, &t->glyphs[first], split);
+    memcpy(frame + split, t->glyphs, t->frameLen - split);
+}
+
+bool ticker_advance(struct Ticker* t)
+{
+    if (!ticker_pending(t))
+    {
+        return false;
+    }
+
+    // Release hands the glyph that scrolled off back to the producer
+    uint32_t tail = atomic_load_explicit(&t->tail, memory_order_relaxed);
+    atomic_store_explicit(&t->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+void ticker_print_stats(const struct Ticker* t, FILE* out)
+{
+    uint32_t head = atomic_load_explicit(&t->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&t->tail, memory_order_relaxed);
+
+    fprintf(out, "ticker: %" PRIu64 " glyphs appended, %" PRIu64 " overruns, %" PRIu64 " glyphs dropped, ring %" PRIu32 "/%" PRIu32 "\n",
+        (uint64_t)atomic_load_explicit(&t->appended, memory_order_relaxed),
+        (uint64_t)atomic_load_explicit(&t->overruns, memory_order_relaxed),
+        (uint64_t)atomic_load_explicit(&t->dropped, memory_order_relaxed),
+        (uint32_t)(head - tail),
+        (uint32_t)TICKER_RING_LEN);
+}
@@ -0,0 +1,92 @@
+/**
+ * @file ticker.h
+ * @brief Ring of encoded glyphs for a ticker that streams indefinitely.
+ *
+ * @note One producer appends glyphs at the head while one consumer scrolls
+ * a window over them from the tail. Glyphs that scrolled off the left edge
+ * are reclaimed, so a feed of any length only needs TICKER_RING_LEN bytes.
+ * Positions are free-running counters, they are masked on every access.
+ * Neither side takes a lock or makes a syscall, and each side only writes
+ * its own cache line, so they don't slow each other down.
+ *
+ * @authors Ognjen Jarcevic RA99/2020, Lazar Vranjes RA19/2020
+ */
+
+#ifndef TICKER_H
+#define TICKER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+/** @brief Number of glyphs the ring holds, a power of two */
+#define TICKER_RING_LEN 4096u
+
+/** @brief Producer and consumer state are kept this far apart, so they never share a cache line */
+#define TICKER_CACHE_LINE 64
+
+struct Ticker
+{
+    /** @brief Number of digits the window shows, only read after ticker_init */
+    uint32_t frameLen;
+
+    /** @brief Encoded glyphs, position `p` is glyphs[p & (TICKER_RING_LEN - 1)] */
+    _Alignas(TICKER_CACHE_LINE) uint8_t glyphs[TICKER_RING_LEN];
+
+    /** @brief Position the next glyph is appended at, written by the producer only */
+    _Alignas(TICKER_CACHE_LINE) atomic_uint_fast32_t head;
+
+    /** @brief Tail the producer saw last, it only reloads `tail` when this one leaves no room */
+    uint32_t tailCache;
+
+    /** @brief Glyphs appended, pushes that found the ring full, and glyphs they dropped, producer side */
+    atomic_uint_fast64_t appended;
+    atomic_uint_fast64_t overruns;
+    atomic_uint_fast64_t dropped;
+
+    /** @brief Position shown on the leftmost digit, written by the consumer only */
+    _Alignas(TICKER_CACHE_LINE) atomic_uint_fast32_t tail;
+
+    /** @brief Head the consumer saw last, it only reloads `head` when this one has nothing new */
+    uint32_t headCache;
+};
+
+/**
+ * @brief Empties the ring, the window starts out blank so the first glyphs enter from the right
+ * @param frameLen number of digits of the window, at most TICKER_RING_LEN / 2
+ */
+void ticker_init(struct Ticker* t, uint32_t frameLen);
+
+/**
+ * @brief Appends up to `count` glyphs, producer side
+ * @retval number of glyphs appended, less than `count` if the ring is full,
+ * the rest can be appended again once the consumer scrolled
+ * @note Doesn't count overruns, the caller waits for room
+ */
+uint32_t ticker_append(struct Ticker* t, const uint8_t* glyphs, uint32_t count);
+
+/**
+ * @brief Appends all `count` glyphs or none of them, producer side, never waits.
+ * Glyphs that don't fit are counted as dropped.
+ * @retval true if the glyphs were appended
+ */
+bool ticker_push(struct Ticker* t, const uint8_t* glyphs, uint32_t count);
+
+/** @brief Tells if glyphs wait to scroll into the window, consumer side */
+bool ticker_pending(struct Ticker* t);
+
+/** @brief Copies the window, `frameLen` digits, leftmost first, consumer side */
+void ticker_frame(const struct Ticker* t, uint8_t* frame);
+
+/**
+ * @brief Scrolls the window one digit left and reclaims the glyph that left it, consumer side
+ * @retval false if no glyph waits to scroll in, the window doesn't move
+ */
+bool ticker_advance(struct Ticker* t);
+
+/** @brief Prints the producer counters and how full the ring is, producer side */
+void ticker_print_stats(const struct Ticker* t, FILE* out);
+
+
+#endif //TICKER_H
@@ -0,0 +1,78 @@
+#include <stdatomic.h>
+#include <inttypes.h>
+#include <time.h>
+#include "trace.h"
+
+struct TraceRecord
+{
+    /** @brief Index of the record + 1, 0 while the record is being written */
+    _Atomic uint32_t seq;
+    /** @brief CLOCK_MONOTONIC time of the instruction, in nanoseconds */
+    uint64_t timestamp;
+    uint8_t reg;
+    uint8_t val;
+};
+
+static struct TraceRecord ring[TRACE_LEN];
+
+/** @brief Index of the next record to be written */
+static _Atomic uint32_t head;
+
+static atomic_bool enabled;
+
+void trace_enable(bool enable)
+{
+    atomic_store_explicit(&enabled, enable, memory_order_relaxed);
+}
+
+bool trace_enabled()
+{
+    return atomic_load_explicit(&enabled, memory_order_relaxed);
+}
+
+void trace_record(uint8_t reg, uint8_t val)
+{
+    if (!atomic_load_explicit(&enabled, memory_order_relaxed))
+    {
+        return;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    // Every writer claims its own slot, no locks needed
+    uint32_t index = atomic_fetch_add_explicit(&head, 1, memory_order_relaxed);
+    struct TraceRecord* r = &ring[index & (TRACE_LEN - 1)];
+
+    atomic_store_explicit(&r->seq, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    r->timestamp = (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+    r->reg = reg;
+    r->val = val;
+    atomic_store_explicit(&r->seq, index + 1, memory_order_release);
+}
+
+void trace_dump(FILE* out)
+{
+    uint32_t end = atomic_load_explicit(&head, memory_order_acquire);
+    uint32_t start = end > TRACE_LEN ? end - TRACE_LEN : 0;
+
+    fprintf(out, "trace: %" PRIu32 " instructions recorded\n", end);
+    for (uint32_t index = start; index != end; index++)
+    {
+        struct TraceRecord* r = &ring[index & (TRACE_LEN - 1)];
+
+        uint32_t seq = atomic_load_explicit(&r->seq, memory_order_acquire);
+        uint64_t timestamp = r->timestamp;
+        uint8_t reg = r->reg;
+        uint8_t val = r->val;
+        atomic_thread_fence(memory_order_acquire);
+
+        // Skips records that are being written or were overwritten meanwhile
+        if (seq != index + 1 || atomic_load_explicit(&r->seq, memory_order_relaxed) != seq)
+        {
+            continue;
+        }
+        fprintf(out, "%" PRIu64 " %02x|%02x\n", timestamp, reg, val);
+    }
+}
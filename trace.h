@@ -0,0 +1,34 @@
+/**
+ * @file trace.h
+ * @brief Lock-free binary trace of instructions sent to the display.
+ *
+ * @note Recording only stores a timestamp, register and value into a fixed-size ring,
+ * formatting is deferred until the trace is dumped.
+ * When the ring is full, the oldest records are overwritten.
+ *
+ * @authors Ognjen Jarcevic RA99/2020, Lazar Vranjes RA19/2020
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/** @brief Number of records kept in the ring, must be a power of two */
+#define TRACE_LEN 1024
+
+/** @brief Turns instruction recording on or off, off by default */
+void trace_enable(bool enable);
+
+/** @brief Tells if instructions are being recorded */
+bool trace_enabled();
+
+/** @brief Records a single instruction, if tracing is enabled. Safe to call from any thread. */
+void trace_record(uint8_t reg, uint8_t val);
+
+/** @brief Prints every record still in the ring, oldest first */
+void trace_dump(FILE* out);
+
+#endif //TRACE_H
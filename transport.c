@@ -0,0 +1,353 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
+#include "transport.h"
+#include "max7219_types.h"
+#include "trace.h"
+
+/** @brief Every known backend, in the order they are probed */
+static const struct Transport* transports[] = {
+    &transport_bcm2835_spi,
+    &transport_spidev,
+    &transport_gpio_bitbang,
+    &transport_bcm2835_bitbang,
+    &transport_gpiochip
+};
+
+#define TRANSPORT_COUNT (sizeof(transports) / sizeof(transports[0]))
+
+const struct Transport* transport_find(const char* name)
+{
+    for (size_t i = 0; i < TRANSPORT_COUNT; i++)
+    {
+        if (strcmp(transports[i]->name, name) == 0)
+        {
+            return transports[i];
+        }
+    }
+    // The simulator is never probed, it would always be the fastest
+    if (strcmp(transport_sim.name, name) == 0)
+    {
+        return &transport_sim;
+    }
+    return NULL;
+}
+
+/** @brief Measures how long a burst of no-op instructions takes, in nanoseconds */
+static int64_t transport_measure(const struct Transport* t)
+{
+    struct timespec start, end;
+    // No-op instructions don't change the display state
+    uint16_t instrs[TRANSPORT_PROBE_INSTR_COUNT] = {TRANSPORT_INSTR(REG_NO_OP, 0)};
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    t->write_batch(instrs, TRANSPORT_PROBE_INSTR_COUNT);
+    t->flush();
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    return (int64_t)(end.tv_sec - start.tv_sec) * 1000000000LL + (end.tv_nsec - start.tv_nsec);
+}
+
+const struct Transport* transport_probe()
+{
+    const struct Transport* fastest = NULL;
+    int64_t fastestTime = 0;
+
+    for (size_t i = 0; i < TRANSPORT_COUNT; i++)
+    {
+        const struct Transport* t = transports[i];
+
+        if (t->init() != 0)
+        {
+            printf("transport %s: unavailable\n", t->name);
+            continue;
+        }
+
+        int64_t time = transport_measure(t);
+        printf("transport %s: %lld ns per %d instructions\n", t->name, (long long)time, TRANSPORT_PROBE_INSTR_COUNT);
+        t->close();
+
+        if (fastest == NULL || time < fastestTime)
+        {
+            fastest = t;
+            fastestTime = time;
+        }
+    }
+
+    // Backends share pins, so only the winner stays initialized
+    if (fastest != NULL && fastest->init() != 0)
+    {
+        return NULL;
+    }
+    return fastest;
+}
+
+/** @brief Number of daisy-chained chips on every lane, chip 0 is wired to the Pi */
+static int chainLen = 1;
+
+/** @brief Number of DIN lanes sharing CLK and LOAD */
+static int lanes = 1;
+
+/**
+ * @brief Last value written to every register of every chip, indexed by chip and register address.
+ * Chips are numbered lane * chainLen + chip.
+ */
+static uint8_t shadow[TRANSPORT_MAX_CHIPS][TRANSPORT_REG_COUNT];
+
+/** @brief Tells if the register's value on the display is known */
+static bool shadowValid[TRANSPORT_MAX_CHIPS][TRANSPORT_REG_COUNT];
+
+/** @brief Keeps the shadow copy in the same order as the instructions on the bus */
+static pthread_mutex_t shadowLock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Takes the shadow lock.
+ * Cancellation is disabled while it is held, the update thread is cancelled on exit.
+ */
+static void transport_lock(int* cancelState)
+{
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, cancelState);
+    pthread_mutex_lock(&shadowLock);
+}
+
+static void transport_unlock(int cancelState)
+{
+    pthread_mutex_unlock(&shadowLock);
+    pthread_setcancelstate(cancelState, NULL);
+}
+
+/**
+ * @brief Updates the shadow copy of a chip, must be called with the shadow lock held
+ * @retval instruction to send to the chip, a no-op if the register already holds the value
+ */
+static uint16_t transport_shadow_update(int chip, uint16_t instr)
+{
+    uint8_t reg = (instr >> 8) & (TRANSPORT_REG_COUNT - 1);
+    uint8_t val = instr & 0xFF;
+
+    if (reg == REG_NO_OP)
+    {
+        return instr;
+    }
+    if (shadowValid[chip][reg] && shadow[chip][reg] == val)
+    {
+        return TRANSPORT_INSTR(REG_NO_OP, 0);
+    }
+    shadow[chip][reg] = val;
+    shadowValid[chip][reg] = true;
+    trace_record(reg, val);
+    return instr;
+}
+
+/**
+ * @brief Sends an instruction to every chip on every lane in one frame, unless every chip got a no-op.
+ * Must be called with the shadow lock held.
+ */
+static void transport_send_chain(const struct Transport* t, const uint16_t* instrs)
+{
+    for (int chip = 0; chip < chainLen * lanes; chip++)
+    {
+        if ((instrs[chip] >> 8) != REG_NO_OP)
+        {
+            t->write_chain(instrs, chainLen, lanes);
+            return;
+        }
+    }
+}
+
+int transport_set_chain_len(const struct Transport* t, int len)
+{
+    int cancelState;
+    int status = 0;
+
+    if (len < 1 || len > TRANSPORT_MAX_CHAIN_LEN)
+    {
+        return 1;
+    }
+    if (t->set_chain_len != NULL)
+    {
+        status = t->set_chain_len(len);
+    }
+
+    transport_lock(&cancelState);
+    if (status == 0)
+    {
+        chainLen = len;
+    }
+    memset(shadowValid, 0, sizeof(shadowValid));
+    transport_unlock(cancelState);
+    return status;
+}
+
+int transport_chain_len()
+{
+    return chainLen;
+}
+
+int transport_set_lanes(const struct Transport* t, int count)
+{
+    int cancelState;
+    int status = 0;
+
+    if (count < 1 || count > TRANSPORT_MAX_LANES)
+    {
+        return 1;
+    }
+    // Backends with a single DIN line only take one lane
+    if (t->set_lanes != NULL)
+    {
+        status = t->set_lanes(count);
+    }
+    else if (count != 1)
+    {
+        status = 1;
+    }
+
+    transport_lock(&cancelState);
+    if (status == 0)
+    {
+        lanes = count;
+    }
+    memset(shadowValid, 0, sizeof(shadowValid));
+    transport_unlock(cancelState);
+    return status;
+}
+
+int transport_chip_count()
+{
+    return chainLen * lanes;
+}
+
+void transport_write(const struct Transport* t, uint8_t reg, uint8_t val)
+{
+    uint16_t instr = TRANSPORT_INSTR(reg, val);
+    transport_write_batch(t, &instr, 1);
+}
+
+void transport_write_batch(const struct Transport* t, const uint16_t* instrs, int count)
+{
+    uint16_t changed[TRANSPORT_REG_COUNT];
+    int changedCount = 0;
+    uint16_t chain[TRANSPORT_MAX_CHIPS];
+    int cancelState;
+
+    transport_lock(&cancelState);
+    for (int i = 0; i < count; i++)
+    {
+        // Every chip gets the same instruction
+        if (chainLen * lanes > 1)
+        {
+            for (int chip = 0; chip < chainLen * lanes; chip++)
+            {
+                chain[chip] = transport_shadow_update(chip, instrs[i]);
+            }
+            transport_send_chain(t, chain);
+            continue;
+        }
+
+        // A single chip takes the whole batch at once
+        uint16_t instr = transport_shadow_update(0, instrs[i]);
+        if ((instr >> 8) == REG_NO_OP && (instrs[i] >> 8) != REG_NO_OP)
+        {
+            continue;
+        }
+        changed[changedCount++] = instr;
+
+        if (changedCount == TRANSPORT_REG_COUNT)
+        {
+            t->write_batch(changed, changedCount);
+            changedCount = 0;
+        }
+    }
+    if (changedCount > 0)
+    {
+        t->write_batch(changed, changedCount);
+    }
+    transport_unlock(cancelState);
+}
+
+void transport_write_frame(const struct Transport* t, const uint8_t* digits)
+{
+    uint16_t instrs[TRANSPORT_FRAME_LEN];
+    uint16_t chain[TRANSPORT_MAX_CHIPS];
+
+    // Digit 7 is the leftmost one
+    if (chainLen * lanes == 1)
+    {
+        for (int i = 0; i < TRANSPORT_FRAME_LEN; i++)
+        {
+            instrs[i] = TRANSPORT_INSTR(REG_DIGIT_7 - i, digits[i]);
+        }
+        transport_write_batch(t, instrs, TRANSPORT_FRAME_LEN);
+        return;
+    }
+
+    int cancelState;
+    transport_lock(&cancelState);
+    for (int i = 0; i < TRANSPORT_FRAME_LEN; i++)
+    {
+        for (int chip = 0; chip < chainLen * lanes; chip++)
+        {
+            uint8_t digit = digits[chip * TRANSPORT_FRAME_LEN + i];
+            chain[chip] = transport_shadow_update(chip, TRANSPORT_INSTR(REG_DIGIT_7 - i, digit));
+        }
+        transport_send_chain(t, chain);
+    }
+    transport_unlock(cancelState);
+}
+
+void transport_shadow_reset()
+{
+    int cancelState;
+
+    transport_lock(&cancelState);
+    memset(shadowValid, 0, sizeof(shadowValid));
+    transport_unlock(cancelState);
+}
+
+void transport_print_stats(const struct Transport* t, FILE* out)
+{
+    int cancelState;
+
+    if (t->print_stats == NULL)
+    {
+        fprintf(out, "transport %s has no stats\n", t->name);
+        return;
+    }
+    transport_lock(&cancelState);
+    t->print_stats(out);
+    transport_unlock(cancelState);
+}
+
+void transport_refresh(const struct Transport* t)
+{
+    uint16_t chain[TRANSPORT_MAX_CHIPS];
+    int cancelState;
+
+    transport_lock(&cancelState);
+    // A backend that skips digits it believes are shown forgets them first
+    if (t->resync != NULL)
+    {
+        t->resync();
+    }
+    for (int reg = 0; reg < TRANSPORT_REG_COUNT; reg++)
+    {
+        // Chips with an unknown value get a no-op
+        for (int chip = 0; chip < chainLen * lanes; chip++)
+        {
+            if (shadowValid[chip][reg])
+            {
+                trace_record(reg, shadow[chip][reg]);
+                chain[chip] = TRANSPORT_INSTR(reg, shadow[chip][reg]);
+            }
+            else
+            {
+                chain[chip] = TRANSPORT_INSTR(REG_NO_OP, 0);
+            }
+        }
+        transport_send_chain(t, chain);
+    }
+    transport_unlock(cancelState);
+}
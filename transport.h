@@ -0,0 +1,193 @@
+/**
+ * @file transport.h
+ * @brief Transport backends used to deliver MAX7219/MAX7221 instructions.
+ *
+ * @note Every backend implements the same function table, so the display
+ * driver can pick one at runtime instead of at compile time.
+ *
+ * @authors Ognjen Jarcevic RA99/2020, Lazar Vranjes RA19/2020
+ */
+
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/** @brief Packs a register and its value into a single 16-bit instruction */
+#define TRANSPORT_INSTR(reg, val) ((uint16_t)(((uint16_t)(uint8_t)(reg) << 8) | (uint8_t)(val)))
+
+/** @brief Number of instructions in a full frame, one per digit register */
+#define TRANSPORT_FRAME_LEN 8
+
+/** @brief Number of MAX7219 register addresses, every address fits in 4 bits */
+#define TRANSPORT_REG_COUNT 16
+
+/** @brief Max number of MAX7219s daisy-chained through DOUT -> DIN */
+#define TRANSPORT_MAX_CHAIN_LEN 8
+
+/** @brief Max number of chains with their own DIN line, sharing CLK and LOAD */
+#define TRANSPORT_MAX_LANES 8
+
+/** @brief Max number of MAX7219s in total */
+#define TRANSPORT_MAX_CHIPS (TRANSPORT_MAX_CHAIN_LEN * TRANSPORT_MAX_LANES)
+
+/** @brief Number of no-op instructions sent per backend while probing */
+#define TRANSPORT_PROBE_INSTR_COUNT 8
+
+struct Transport
+{
+    /** @brief Backend name, used to select the backend from the command line */
+    const char* name;
+
+    /**
+     * @brief Acquires and configures the backend's pins/devices
+     * @retval 0 on success or an error code
+     */
+    int (*init)(void);
+
+    /** @brief Sends a single 16-bit instruction to the display */
+    void (*write)(uint8_t reg, uint8_t val);
+
+    /**
+     * @brief Sends `count` instructions, packed with TRANSPORT_INSTR, in order
+     * @note Backends submit the whole batch at once where they can
+     */
+    void (*write_batch)(const uint16_t* instrs, int count);
+
+    /**
+     * @brief Sends one instruction to every chip of a daisy chain, in a single LOAD/CS frame
+     * of chainLen x 16 bits. instrs[0] is for the chip wired to the Pi, so it is shifted out last.
+     * With multiple lanes, every lane's chain is shifted out in parallel on its own DIN line,
+     * instrs[lane * chainLen + chip] is for `chip` of `lane`.
+     */
+    void (*write_chain)(const uint16_t* instrs, int chainLen, int lanes);
+
+    /**
+     * @brief Tells the backend how many chips are chained, NULL if the backend doesn't need to know
+     * @retval 0 on success or an error code
+     */
+    int (*set_chain_len)(int chainLen);
+
+    /**
+     * @brief Sets the number of DIN lanes sharing CLK and LOAD, NULL if the backend has a single DIN line
+     * @retval 0 on success or an error code
+     */
+    int (*set_lanes)(int lanes);
+
+    /**
+     * @brief Forgets what the backend knows the display shows, so nothing it sends later is skipped,
+     * NULL if the backend doesn't keep track of it
+     */
+    void (*resync)(void);
+
+    /** @brief Waits until every written instruction reaches the display */
+    void (*flush)(void);
+
+    /** @brief Releases everything acquired by `init` */
+    void (*close)(void);
+
+    /** @brief Prints the backend's bus load counters, NULL if the backend doesn't keep any */
+    void (*print_stats)(FILE* out);
+};
+
+/** @brief bcm2835 library with hardware SPI pins and functions */
+extern const struct Transport transport_bcm2835_spi;
+
+/** @brief bcm2835 library GPIO functions, bitbanging the MAX7219 spi */
+extern const struct Transport transport_bcm2835_bitbang;
+
+/** @brief gpio_bitbang Linux kernel driver */
+extern const struct Transport transport_gpio_bitbang;
+
+/** @brief Linux spidev driver, a whole frame per SPI_IOC_MESSAGE syscall */
+extern const struct Transport transport_spidev;
+
+/**
+ * @brief ioctl behind every spidev call, ioctl(2) by default.
+ * Tests replace it to record the SPI_IOC_MESSAGE transfers without a device.
+ */
+extern int (*transport_spidev_ioctl)(int fd, unsigned long request, void* arg);
+
+/** @brief Linux GPIO character device, bitbanging every edge with one line-values syscall */
+extern const struct Transport transport_gpiochip;
+
+/**
+ * @brief Simulated MAX7219s executing the instruction stream in memory, no Pi needed.
+ * The stats command renders their digits. Only selected by name, never probed.
+ */
+extern const struct Transport transport_sim;
+
+/**
+ * @brief Finds a backend by its name
+ *
+ * @retval backend, or NULL if no backend is called `name`
+*/
+const struct Transport* transport_find(const char* name);
+
+/**
+ * @brief Initializes every backend, times a burst of no-op instructions through it,
+ * and keeps the fastest one initialized.
+ *
+ * @retval fastest initialized backend, or NULL if none could be initialized
+*/
+const struct Transport* transport_probe();
+
+/**
+ * @brief Sets the number of daisy-chained chips and forgets the shadow copy
+ *
+ * @retval 0 on success or an error code
+*/
+int transport_set_chain_len(const struct Transport* t, int chainLen);
+
+/** @brief Number of daisy-chained chips */
+int transport_chain_len();
+
+/**
+ * @brief Sets the number of DIN lanes, each driving its own chain, and forgets the shadow copy.
+ * All lanes are updated by the same CLK edges, so K lanes take as long as one.
+ *
+ * @retval 0 on success or an error code
+*/
+int transport_set_lanes(const struct Transport* t, int lanes);
+
+/** @brief Number of chips on all lanes */
+int transport_chip_count();
+
+/**
+ * @brief Writes a single register of every chip in the chain, unless it already holds `val`.
+ *
+ * @note Every register written through the transport_write functions is kept in a
+ * per-chip shadow copy, so only registers that change reach the bus.
+ * Chips whose register doesn't change get a no-op instruction in the chain frame.
+ * Safe to call from multiple threads.
+ */
+void transport_write(const struct Transport* t, uint8_t reg, uint8_t val);
+
+/** @brief transport_write for `count` packed instructions, in order, as one batch where possible */
+void transport_write_batch(const struct Transport* t, const uint16_t* instrs, int count);
+
+/**
+ * @brief Writes the digits of every chip in the chain, skipping digits that don't change.
+ *
+ * @param digits transport_chip_count() x TRANSPORT_FRAME_LEN digits, leftmost first.
+ * The chip wired to the Pi shows the leftmost TRANSPORT_FRAME_LEN digits of its lane,
+ * lane 0 shows the leftmost digits of the sign.
+ * @note Every digit row goes out as one chain frame, so the whole sign takes
+ * at most TRANSPORT_FRAME_LEN transactions.
+ */
+void transport_write_frame(const struct Transport* t, const uint8_t* digits);
+
+/** @brief Forgets the shadow copy, the next write of every register reaches the bus */
+void transport_shadow_reset();
+
+/** @brief Resends every register in the shadow copy, recovering a display that lost its state */
+void transport_refresh(const struct Transport* t);
+
+/**
+ * @brief Prints the backend's counters, in the same order as the instructions on the bus,
+ * so the backend's state isn't read while the update thread writes it
+ */
+void transport_print_stats(const struct Transport* t, FILE* out);
+
+#endif //TRANSPORT_H
@@ -0,0 +1,225 @@
+#include <time.h>
+#include "transport.h"
+#include "bcm2835.h"
+#include "bcm_bitbang.h"
+
+#define CLK_MASK (1 << BCM_BITBANG_CLK_PIN)
+#define LOAD_MASK (1 << BCM_BITBANG_LOAD_PIN)
+
+/** @brief Number of DIN lanes sharing CLK and LOAD */
+static int lanes = 1;
+
+/** @brief DIN pin mask of every lane, and of all of them */
+static uint32_t dinMasks[BCM_BITBANG_MAX_LANES] = {1 << BCM_BITBANG_DIN_PIN};
+static uint32_t dinAllMask = 1 << BCM_BITBANG_DIN_PIN;
+
+/** @brief Busy loop iterations per microsecond, calibrated at init */
+static uint32_t loopsPerUsec = 1;
+
+/** @brief Busy loop iterations of a CLK half period and of the LOAD pulse */
+static uint32_t halfPeriodLoops = 1;
+static uint32_t loadWidthLoops = 1;
+
+/** @brief GPSET0 and GPCLR0, every bitbang pin is in the first bank */
+static volatile uint32_t* gpset;
+static volatile uint32_t* gpclr;
+
+static void bitbang_spin(uint32_t loops)
+{
+    for (volatile uint32_t i = loops; i > 0; i--)
+        ;
+}
+
+/** @brief Converts nanoseconds into busy loop iterations, rounded up */
+static uint32_t bitbang_loops(uint32_t nsec)
+{
+    uint32_t loops = (nsec * loopsPerUsec + 999) / 1000;
+    return loops > 0 ? loops : 1;
+}
+
+/**
+ * @brief Times the busy loop against the 1 MHz system timer.
+ * Sub-microsecond delays are then counted in loop iterations, with no peripheral access.
+ */
+static void bitbang_calibrate(void)
+{
+    uint64_t start = bcm2835_st_read();
+    bitbang_spin(BCM_BITBANG_CALIBRATION_LOOPS);
+    uint64_t elapsed = bcm2835_st_read() - start;
+
+    // System timer isn't mapped in debug mode
+    if (elapsed == 0)
+    {
+        struct timespec begin, end;
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        bitbang_spin(BCM_BITBANG_CALIBRATION_LOOPS);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        elapsed = ((uint64_t)(end.tv_sec - begin.tv_sec) * 1000000000ULL + end.tv_nsec - begin.tv_nsec) / 1000;
+    }
+
+    loopsPerUsec = elapsed > 0 ? (BCM_BITBANG_CALIBRATION_LOOPS + elapsed - 1) / elapsed : 1;
+    halfPeriodLoops = bitbang_loops(BCM_BITBANG_HALF_PERIOD_NS);
+    loadWidthLoops = bitbang_loops(BCM_BITBANG_LOAD_WIDTH_NS);
+}
+
+static int bitbang_set_lanes(int count)
+{
+    const uint8_t pins[BCM_BITBANG_MAX_LANES] = BCM_BITBANG_LANE_DIN_PINS;
+
+    if (count > BCM_BITBANG_MAX_LANES)
+    {
+        return 1;
+    }
+
+    dinAllMask = 0;
+    for (int lane = 0; lane < count; lane++)
+    {
+        bcm2835_gpio_fsel(pins[lane], BCM2835_GPIO_FSEL_OUTP);
+        dinMasks[lane] = 1 << pins[lane];
+        dinAllMask |= dinMasks[lane];
+    }
+    lanes = count;
+    return 0;
+}
+
+static int bitbang_init(void)
+{
+    if (!bcm2835_init())
+    {
+        return 1;
+    }
+
+    // Configures the neccessary GPIO pins into output pins
+    bcm2835_gpio_fsel(BCM_BITBANG_LOAD_PIN, BCM2835_GPIO_FSEL_OUTP); //RPI_V2_GPIO_P1_13
+    bcm2835_gpio_fsel(BCM_BITBANG_CLK_PIN, BCM2835_GPIO_FSEL_OUTP); //RPI_V2_GPIO_P1_15
+
+    gpset = bcm2835_gpio + BCM2835_GPSET0/4;
+    gpclr = bcm2835_gpio + BCM2835_GPCLR0/4;
+    // Lane 0 is BCM_BITBANG_DIN_PIN, RPI_V2_GPIO_P1_11
+    bitbang_set_lanes(1);
+
+    bitbang_calibrate();
+    return 0;
+}
+
+/**
+ * @brief Shifts one instruction per lane out, MSB first, without latching them.
+ * Every CLK edge is one GPCLR0/GPSET0 write. DIN of every lane that goes low is cleared
+ * together with the falling CLK, lanes that go high are set with one more write, only if any.
+ * No barriers in between, the GPIO block is the only peripheral accessed.
+ *
+ * @param bits bits[lane] is shifted out on the lane's DIN pin
+ * @param dinState DIN pins that are currently high
+ */
+static void bitbang_shift(const uint16_t* bits, uint32_t* dinState)
+{
+    uint32_t din = *dinState;
+
+    for (int i = 15; i >= 0; i--)
+    {
+        uint32_t ones = 0;
+        for (int lane = 0; lane < lanes; lane++)
+        {
+            if ((bits[lane] >> i) & 1)
+            {
+                ones |= dinMasks[lane];
+            }
+        }
+
+        // Falling CLK, with the DIN lines that go low
+        bcm2835_peri_write_nb(gpclr, CLK_MASK | (din & ~ones));
+        if (ones & ~din)
+        {
+            bcm2835_peri_write_nb(gpset, ones & ~din);
+        }
+        din = ones;
+        bitbang_spin(halfPeriodLoops);
+
+        // Processes the bit on the rising edge
+        bcm2835_peri_write_nb(gpset, CLK_MASK);
+        bitbang_spin(halfPeriodLoops);
+    }
+    *dinState = din;
+}
+
+/**
+ * @brief Shifts `count` instructions out of every lane within one LOAD frame.
+ * instrs[i * lanes + lane] is the i-th instruction shifted out of `lane`.
+ */
+static void bitbang_frame(const uint16_t* instrs, int count)
+{
+    // Data is shifted in while LOAD is low, DIN starts low
+    bcm2835_peri_write_nb(gpclr, LOAD_MASK | CLK_MASK | dinAllMask);
+    uint32_t din = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        bitbang_shift(&instrs[i * lanes], &din);
+    }
+
+    // Every chip latches its last 16 bits on the rising edge
+    bcm2835_peri_write_nb(gpset, LOAD_MASK);
+    bitbang_spin(loadWidthLoops);
+}
+
+static void bitbang_write_batch(const uint16_t* instrs, int count)
+{
+    uint16_t fanned[BCM_BITBANG_MAX_LANES];
+
+    // Orders against accesses to other peripherals, once per batch
+    __sync_synchronize();
+    for (int i = 0; i < count; i++)
+    {
+        // A frame takes an instruction for every lane, each lane gets the same one
+        for (int lane = 0; lane < lanes; lane++)
+        {
+            fanned[lane] = instrs[i];
+        }
+        bitbang_frame(fanned, 1);
+    }
+    __sync_synchronize();
+}
+
+static void bitbang_write_chain(const uint16_t* instrs, int chainLen, int laneCount)
+{
+    uint16_t shifted[TRANSPORT_MAX_CHIPS];
+
+    // The farthest chip's instruction goes first, lanes are interleaved bit by bit
+    for (int lane = 0; lane < laneCount; lane++)
+    {
+        for (int chip = 0; chip < chainLen; chip++)
+        {
+            shifted[(chainLen - 1 - chip) * laneCount + lane] = instrs[lane * chainLen + chip];
+        }
+    }
+    __sync_synchronize();
+    bitbang_frame(shifted, chainLen);
+    __sync_synchronize();
+}
+
+static void bitbang_write(uint8_t reg, uint8_t val)
+{
+    uint16_t instr = TRANSPORT_INSTR(reg, val);
+    bitbang_write_batch(&instr, 1);
+}
+
+static void bitbang_flush(void)
+{
+    // Every edge is written synchronously
+}
+
+static void bitbang_close(void)
+{
+    bcm2835_close();
+}
+
+const struct Transport transport_bcm2835_bitbang = {
+    .name = "bcm_bitbang",
+    .init = bitbang_init,
+    .write = bitbang_write,
+    .write_batch = bitbang_write_batch,
+    .write_chain = bitbang_write_chain,
+    .set_lanes = bitbang_set_lanes,
+    .flush = bitbang_flush,
+    .close = bitbang_close
+};
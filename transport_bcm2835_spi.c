@@ -0,0 +1,228 @@
+#include <stdio.h>
+#include <stdbool.h>
+#include "transport.h"
+#include "max7219_types.h"
+#include "bcm2835.h"
+
+#define SPI_INSTR_LEN 2
+
+/** @brief Max CLK frequency the MAX7219 is rated for */
+#define SPI_MAX_SPEED_HZ 10000000
+
+/** @brief Speed used if the loopback can't be verified, MISO not wired to DOUT */
+#define SPI_FALLBACK_SPEED_HZ 1000000
+
+/** @brief Slowest divider tried while tuning, ~490 kHz */
+#define SPI_TUNE_START_DIVIDER 512
+
+/** @brief Loopback transfers that must all pass at a speed */
+#define SPI_TUNE_TRIALS 16
+
+/**
+ * @brief Patterns shifted through the chain while tuning.
+ * Register bits D11-D8 are 0, so every pattern is a no-op wherever it gets latched.
+ */
+static const uint16_t tunePatterns[] = {0xA055, 0x50AA, 0xF0F0, 0x000F};
+
+#define SPI_TUNE_PATTERN_COUNT (sizeof(tunePatterns) / sizeof(tunePatterns[0]))
+
+/** @brief Bus speed in use and the number of chips the loopback went through, 0 if not verified */
+static uint32_t speedHz = SPI_FALLBACK_SPEED_HZ;
+static int loopbackChips = 0;
+
+/** @brief Current/last SPI instruction sent to the display */
+static char instr[SPI_INSTR_LEN];
+
+/** @brief Current/last chain frame sent to the display */
+static char chain[SPI_INSTR_LEN * TRANSPORT_MAX_CHAIN_LEN];
+
+/**
+ * @brief Shifts the tune patterns through the chain, followed by no-ops, and reads DOUT of the
+ * last chip back on MISO. Every chip delays the data by 16 clocks, so the patterns must come
+ * back intact, one instruction later per chip.
+ *
+ * @param trial varies the data bits between transfers
+ * @retval number of chips the patterns went through, 0 if they didn't come back
+ */
+static int spi_loopback(int trial)
+{
+    // The chain latches no-ops at the end, whatever its length
+    char tx[(SPI_TUNE_PATTERN_COUNT + TRANSPORT_MAX_CHAIN_LEN) * SPI_INSTR_LEN] = {REG_NO_OP};
+    char rx[sizeof(tx)];
+    uint16_t expected[SPI_TUNE_PATTERN_COUNT];
+
+    for (size_t i = 0; i < SPI_TUNE_PATTERN_COUNT; i++)
+    {
+        expected[i] = tunePatterns[i] ^ (trial & 0xFF);
+        tx[i * SPI_INSTR_LEN] = expected[i] >> 8;
+        tx[i * SPI_INSTR_LEN + 1] = expected[i] & 0xFF;
+    }
+    bcm2835_spi_transfernb(tx, rx, sizeof(tx));
+
+    // Before the patterns, DOUT shifts out whatever the chips held
+    for (int chips = 1; chips <= TRANSPORT_MAX_CHAIN_LEN; chips++)
+    {
+        bool match = true;
+        for (size_t i = 0; i < SPI_TUNE_PATTERN_COUNT && match; i++)
+        {
+            const char* word = &rx[(chips + i) * SPI_INSTR_LEN];
+            match = (uint16_t)(((uint8_t)word[0] << 8) | (uint8_t)word[1]) == expected[i];
+        }
+        if (match)
+        {
+            return chips;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Runs SPI_TUNE_TRIALS loopback transfers at `speed`
+ * @retval number of chips the patterns went through, 0 if any trial failed
+ */
+static int spi_verify(uint32_t speed)
+{
+    int chips = 0;
+
+    bcm2835_spi_set_speed_hz(speed);
+    for (int trial = 0; trial < SPI_TUNE_TRIALS; trial++)
+    {
+        int found = spi_loopback(trial);
+        // Every trial has to see the same chain
+        if (found == 0 || (chips != 0 && found != chips))
+        {
+            return 0;
+        }
+        chips = found;
+    }
+    return chips;
+}
+
+/**
+ * @brief Walks the bus speed upward, up to the MAX7219 rating, while the loopback passes.
+ * If a step fails, the one below the fastest passing step is kept, as margin against the wiring.
+ * Falls back to SPI_FALLBACK_SPEED_HZ if the loopback never passes.
+ */
+static void spi_tune(void)
+{
+    uint32_t passed = 0, margin = 0;
+    int passedChips = 0, marginChips = 0;
+    bool failed = false;
+
+    for (int divider = SPI_TUNE_START_DIVIDER; divider >= 2; divider = (divider * 4 / 5) & ~1)
+    {
+        uint32_t speed = BCM2835_CORE_CLK_HZ / divider;
+        if (speed > SPI_MAX_SPEED_HZ)
+        {
+            break;
+        }
+
+        int chips = spi_verify(speed);
+        if (chips == 0)
+        {
+            failed = true;
+            break;
+        }
+        margin = passed;
+        marginChips = passedChips;
+        passed = speed;
+        passedChips = chips;
+    }
+
+    speedHz = passed;
+    loopbackChips = passedChips;
+    if (failed && margin != 0)
+    {
+        speedHz = margin;
+        loopbackChips = marginChips;
+    }
+    if (speedHz == 0)
+    {
+        speedHz = SPI_FALLBACK_SPEED_HZ;
+    }
+    bcm2835_spi_set_speed_hz(speedHz);
+
+    if (loopbackChips == 0)
+    {
+        printf("spi loopback not verified, DOUT not wired to MISO? Using %u Hz\n", speedHz);
+    }
+    else
+    {
+        printf("spi tuned to %u Hz, loopback through %d chips\n", speedHz, loopbackChips);
+    }
+}
+
+static void spi_print_stats(FILE* out)
+{
+    fprintf(out, "spi: %u Hz, loopback %s\n", speedHz, loopbackChips != 0 ? "verified" : "not verified");
+}
+
+static int spi_init(void)
+{
+    if (!bcm2835_init())
+    {
+        return 1;
+    }
+    if (!bcm2835_spi_begin())
+    {
+        bcm2835_close();
+        return 2;
+    }
+    printf("bcm2835 spi init\n");
+
+    bcm2835_spi_chipSelect(BCM2835_SPI_CS0);
+    spi_tune();
+    return 0;
+}
+
+static void spi_write(uint8_t reg, uint8_t val)
+{
+    instr[0] = reg;
+    instr[1] = val;
+    bcm2835_spi_writenb(instr, SPI_INSTR_LEN);
+}
+
+static void spi_write_batch(const uint16_t* instrs, int count)
+{
+    // Every instruction needs its own CS frame to be latched
+    for (int i = 0; i < count; i++)
+    {
+        spi_write(instrs[i] >> 8, instrs[i] & 0xFF);
+    }
+}
+
+static void spi_write_chain(const uint16_t* instrs, int chainLen, int lanes)
+{
+    // Hardware SPI has a single MOSI line, lanes is always 1
+    (void)lanes;
+    // CS stays low for the whole transfer, the farthest chip's instruction goes first
+    for (int chip = 0; chip < chainLen; chip++)
+    {
+        int offset = (chainLen - 1 - chip) * SPI_INSTR_LEN;
+        chain[offset] = instrs[chip] >> 8;
+        chain[offset + 1] = instrs[chip] & 0xFF;
+    }
+    bcm2835_spi_writenb(chain, chainLen * SPI_INSTR_LEN);
+}
+
+static void spi_flush(void)
+{
+    // bcm2835_spi_writenb returns only after the transfer is DONE
+}
+
+static void spi_close(void)
+{
+    bcm2835_spi_end();
+    bcm2835_close();
+}
+
+const struct Transport transport_bcm2835_spi = {
+    .name = "spi",
+    .init = spi_init,
+    .write = spi_write,
+    .write_batch = spi_write_batch,
+    .write_chain = spi_write_chain,
+    .flush = spi_flush,
+    .close = spi_close,
+    .print_stats = spi_print_stats
+};
@@ -0,0 +1,218 @@
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include "transport.h"
+#include "max7219_types.h"
+#include "gpio_bitbang/gpio_bitbang.h"
+
+/** @brief File descriptor for the gpio_bitbang driver*/
+static int gpio_fd = -1;
+
+/**
+ * @brief Framebuffer shared with the driver, NULL if the driver doesn't support mmap.
+ * Digits stored here are pushed by the driver without any syscall.
+ */
+static struct gpio_bitbang_fb* fb = NULL;
+
+/** @brief Number of chips on every lane and number of lanes, the framebuffer is only used for a single chip */
+static int chainLen = 1;
+static int lanes = 1;
+
+/** @brief Serializes framebuffer updates, the sequence counter allows only one writer */
+static pthread_mutex_t fbLock = PTHREAD_MUTEX_INITIALIZER;
+
+static int gpio_bitbang_init(void)
+{
+    gpio_fd = open(GPIO_BITBANG_DEV_FN, O_RDWR);
+    if (gpio_fd < 0)
+    {
+        printf("ERROR: \"%s\" not opened!\n", GPIO_BITBANG_DEV_FN);
+        return 4;
+    }
+    printf("gpio_bitbang kernel driver opened, %d!\n", gpio_fd);
+
+    // A previous user may have left a chain or lanes configured
+    uint8_t single = 1;
+    ioctl(gpio_fd, GPIO_BITBANG_IOC_SET_CHAIN_LEN, &single);
+    ioctl(gpio_fd, GPIO_BITBANG_IOC_SET_LANES, &single);
+    chainLen = 1;
+    lanes = 1;
+
+    // Falls back to write() for digits if the framebuffer can't be mapped
+    fb = mmap(NULL, sizeof(struct gpio_bitbang_fb), PROT_READ | PROT_WRITE, MAP_SHARED, gpio_fd, 0);
+    if (fb == MAP_FAILED)
+    {
+        printf("gpio_bitbang framebuffer not mapped, using write()\n");
+        fb = NULL;
+    }
+    return 0;
+}
+
+static bool gpio_bitbang_isDigit(uint8_t reg)
+{
+    return reg >= REG_DIGIT_0 && reg <= REG_DIGIT_7;
+}
+
+static void gpio_bitbang_write_batch(const uint16_t* instrs, int count)
+{
+    uint16_t others[GPIO_BITBANG_MAX_INSTR];
+    int othersCount = 0;
+    uint8_t digits[GPIO_BITBANG_DIGIT_COUNT];
+    uint8_t digitMask = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        uint8_t reg = instrs[i] >> 8;
+
+        // Digits only need a store into the framebuffer, done after every syscall
+        if (fb != NULL && chainLen * lanes == 1 && gpio_bitbang_isDigit(reg))
+        {
+            digits[reg - REG_DIGIT_0] = instrs[i] & 0xFF;
+            digitMask |= 1 << (reg - REG_DIGIT_0);
+            continue;
+        }
+
+        // Everything else goes through the driver's queue,
+        // the driver takes up to GPIO_BITBANG_MAX_INSTR instructions per syscall
+        others[othersCount++] = instrs[i];
+        if (othersCount == GPIO_BITBANG_MAX_INSTR)
+        {
+            write(gpio_fd, (const char*)others, othersCount * GPIO_BITBANG_INSTR_LEN);
+            othersCount = 0;
+        }
+    }
+
+    if (othersCount > 0)
+    {
+        write(gpio_fd, (const char*)others, othersCount * GPIO_BITBANG_INSTR_LEN);
+    }
+    if (digitMask == 0)
+    {
+        return;
+    }
+
+    // The sequence number is odd only for the stores, write() may block on a full queue
+    // and the driver can't push the framebuffer meanwhile
+    pthread_mutex_lock(&fbLock);
+    atomic_fetch_add_explicit((_Atomic uint32_t*)&fb->seq, 1, memory_order_acq_rel);
+    for (int digit = 0; digit < GPIO_BITBANG_DIGIT_COUNT; digit++)
+    {
+        if (digitMask & (1 << digit))
+        {
+            fb->digits[digit] = digits[digit];
+        }
+    }
+    // Even sequence number publishes the new digits
+    atomic_fetch_add_explicit((_Atomic uint32_t*)&fb->seq, 1, memory_order_release);
+    pthread_mutex_unlock(&fbLock);
+}
+
+static void gpio_bitbang_write(uint8_t reg, uint8_t val)
+{
+    uint16_t instr = TRANSPORT_INSTR(reg, val);
+    gpio_bitbang_write_batch(&instr, 1);
+}
+
+static void gpio_bitbang_write_chain(const uint16_t* instrs, int len, int laneCount)
+{
+    uint16_t shifted[GPIO_BITBANG_MAX_INSTR];
+
+    // The driver shifts the first instruction of a lane out first, so it ends up in the farthest chip
+    for (int lane = 0; lane < laneCount; lane++)
+    {
+        for (int chip = 0; chip < len; chip++)
+        {
+            shifted[lane * len + len - 1 - chip] = instrs[lane * len + chip];
+        }
+    }
+    write(gpio_fd, (const char*)shifted, len * laneCount * GPIO_BITBANG_INSTR_LEN);
+}
+
+static int gpio_bitbang_set_lanes(int count)
+{
+    uint8_t arg = count;
+
+    if (ioctl(gpio_fd, GPIO_BITBANG_IOC_SET_LANES, &arg) < 0)
+    {
+        printf("ERROR: gpio_bitbang %d lanes not set!\n", count);
+        return 6;
+    }
+    lanes = count;
+    return 0;
+}
+
+static int gpio_bitbang_set_chain_len(int len)
+{
+    uint8_t arg = len;
+
+    if (ioctl(gpio_fd, GPIO_BITBANG_IOC_SET_CHAIN_LEN, &arg) < 0)
+    {
+        printf("ERROR: gpio_bitbang chain length %d not set!\n", len);
+        return 5;
+    }
+    chainLen = len;
+    return 0;
+}
+
+static void gpio_bitbang_resync(void)
+{
+    // The driver skips framebuffer digits it believes the display already shows
+    if (ioctl(gpio_fd, GPIO_BITBANG_IOC_RESYNC) < 0)
+    {
+        printf("ERROR: gpio_bitbang resync failed!\n");
+    }
+}
+
+static void gpio_bitbang_flush(void)
+{
+    // write() only enqueues and the framebuffer is pushed periodically,
+    // fsync() waits for both to reach the display
+    fsync(gpio_fd);
+}
+
+static void gpio_bitbang_close(void)
+{
+    if (fb != NULL)
+    {
+        munmap(fb, sizeof(struct gpio_bitbang_fb));
+        fb = NULL;
+    }
+    close(gpio_fd);
+    gpio_fd = -1;
+}
+
+static void gpio_bitbang_print_stats(FILE* out)
+{
+    struct gpio_bitbang_stats stats;
+
+    if (ioctl(gpio_fd, GPIO_BITBANG_IOC_GET_STATS, &stats) < 0)
+    {
+        fprintf(out, "gpio_bitbang stats not available\n");
+        return;
+    }
+    fprintf(out, "gpio_bitbang: %llu instructions, %llu bytes, %llu ns busy, queue %u/%u\n",
+        (unsigned long long)stats.instructions,
+        (unsigned long long)stats.bytes,
+        (unsigned long long)stats.busy_ns,
+        stats.queue_depth,
+        stats.queue_len);
+}
+
+const struct Transport transport_gpio_bitbang = {
+    .name = "gpio_bitbang",
+    .init = gpio_bitbang_init,
+    .write = gpio_bitbang_write,
+    .write_batch = gpio_bitbang_write_batch,
+    .write_chain = gpio_bitbang_write_chain,
+    .set_chain_len = gpio_bitbang_set_chain_len,
+    .set_lanes = gpio_bitbang_set_lanes,
+    .resync = gpio_bitbang_resync,
+    .flush = gpio_bitbang_flush,
+    .close = gpio_bitbang_close,
+    .print_stats = gpio_bitbang_print_stats
+};
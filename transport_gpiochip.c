@@ -0,0 +1,234 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/gpio.h>
+#include "transport.h"
+#include "bcm_bitbang.h"
+
+/** @brief GPIO character device of the 40-pin header, DISPLAY_GPIOCHIP overrides it (Pi 5) */
+#define GPIOCHIP_DEV_FN "/dev/gpiochip0"
+
+/** @brief Consumer name shown by gpioinfo */
+#define GPIOCHIP_CONSUMER "displej"
+
+/** @brief Bits of the requested lines in gpio_v2_line_values, DIN of lane `n` is GPIOCHIP_DIN(n) */
+#define GPIOCHIP_CLK (1ULL << 0)
+#define GPIOCHIP_LOAD (1ULL << 1)
+#define GPIOCHIP_DIN(lane) (1ULL << (2 + (lane)))
+
+/** @brief File descriptors of the chip and of the requested lines */
+static int chip_fd = -1;
+static int line_fd = -1;
+
+/** @brief Number of DIN lanes sharing CLK and LOAD */
+static int lanes = 1;
+
+/** @brief GPIO_V2_LINE_SET_VALUES_IOCTL syscalls and instructions sent */
+static uint64_t syscalls;
+static uint64_t instructions;
+
+/**
+ * @brief Requests CLK, LOAD and the DIN pin of every lane as outputs, in one line request,
+ * so all of them are set by one syscall
+ * @retval 0 on success or an error code
+ */
+static int gpiochip_request(int count)
+{
+    const uint8_t dinPins[BCM_BITBANG_MAX_LANES] = BCM_BITBANG_LANE_DIN_PINS;
+    struct gpio_v2_line_request req;
+
+    memset(&req, 0, sizeof(req));
+    req.offsets[0] = BCM_BITBANG_CLK_PIN;
+    req.offsets[1] = BCM_BITBANG_LOAD_PIN;
+    for (int lane = 0; lane < count; lane++)
+    {
+        req.offsets[2 + lane] = dinPins[lane];
+    }
+    req.num_lines = 2 + count;
+    req.config.flags = GPIO_V2_LINE_FLAG_OUTPUT;
+    strncpy(req.consumer, GPIOCHIP_CONSUMER, sizeof(req.consumer) - 1);
+
+    // Lines are busy while a previous request holds them
+    if (line_fd >= 0)
+    {
+        close(line_fd);
+        line_fd = -1;
+    }
+    if (ioctl(chip_fd, GPIO_V2_GET_LINE_IOCTL, &req) < 0)
+    {
+        return 10;
+    }
+    line_fd = req.fd;
+    lanes = count;
+    return 0;
+}
+
+static int gpiochip_init(void)
+{
+    const char* chipFn = getenv("DISPLAY_GPIOCHIP");
+    if (chipFn == NULL)
+    {
+        chipFn = GPIOCHIP_DEV_FN;
+    }
+
+    chip_fd = open(chipFn, O_RDWR);
+    if (chip_fd < 0)
+    {
+        printf("ERROR: \"%s\" not opened!\n", chipFn);
+        return 9;
+    }
+
+    int status = gpiochip_request(1);
+    if (status != 0)
+    {
+        printf("ERROR: %s lines not requested!\n", chipFn);
+        close(chip_fd);
+        chip_fd = -1;
+        return status;
+    }
+    printf("gpiochip %s opened, %d!\n", chipFn, line_fd);
+    return 0;
+}
+
+/** @brief Sets the lines in `mask` to `bits` with a single syscall */
+static void gpiochip_set(uint64_t bits, uint64_t mask)
+{
+    struct gpio_v2_line_values values = {.bits = bits, .mask = mask};
+
+    ioctl(line_fd, GPIO_V2_LINE_SET_VALUES_IOCTL, &values);
+    syscalls++;
+}
+
+/**
+ * @brief Shifts `count` instructions out of every lane within one LOAD frame.
+ * instrs[i * lanes + lane] is the i-th instruction shifted out of `lane`.
+ *
+ * @note Every bit takes two syscalls: CLK falls together with the new DIN values,
+ * then rises. LOAD falls with the first bit, so a frame of 16 x count bits takes
+ * 32 x count + 1 syscalls. A syscall takes far longer than the MAX7219's 50 ns
+ * timing minimums, so no delays are needed.
+ */
+static void gpiochip_frame(const uint16_t* instrs, int count)
+{
+    uint64_t dinMask = 0;
+    for (int lane = 0; lane < lanes; lane++)
+    {
+        dinMask |= GPIOCHIP_DIN(lane);
+    }
+    uint64_t loadMask = GPIOCHIP_LOAD;
+
+    for (int i = 0; i < count; i++)
+    {
+        const uint16_t* bits = &instrs[i * lanes];
+
+        for (int b = 15; b >= 0; b--)
+        {
+            uint64_t din = 0;
+            for (int lane = 0; lane < lanes; lane++)
+            {
+                if ((bits[lane] >> b) & 1)
+                {
+                    din |= GPIOCHIP_DIN(lane);
+                }
+            }
+
+            // Falling CLK with DIN, and LOAD low on the first bit
+            gpiochip_set(din, GPIOCHIP_CLK | dinMask | loadMask);
+            loadMask = 0;
+
+            // Processes the bit on the rising edge
+            gpiochip_set(GPIOCHIP_CLK, GPIOCHIP_CLK);
+        }
+    }
+
+    // Every chip latches its last 16 bits on the rising edge
+    gpiochip_set(GPIOCHIP_LOAD, GPIOCHIP_LOAD);
+    instructions += count * lanes;
+}
+
+static void gpiochip_write_batch(const uint16_t* instrs, int count)
+{
+    uint16_t fanned[BCM_BITBANG_MAX_LANES];
+
+    for (int i = 0; i < count; i++)
+    {
+        // A frame takes an instruction for every lane, each lane gets the same one
+        for (int lane = 0; lane < lanes; lane++)
+        {
+            fanned[lane] = instrs[i];
+        }
+        gpiochip_frame(fanned, 1);
+    }
+}
+
+static void gpiochip_write(uint8_t reg, uint8_t val)
+{
+    uint16_t instr = TRANSPORT_INSTR(reg, val);
+    gpiochip_write_batch(&instr, 1);
+}
+
+static void gpiochip_write_chain(const uint16_t* instrs, int chainLen, int laneCount)
+{
+    uint16_t shifted[TRANSPORT_MAX_CHIPS];
+
+    // The farthest chip's instruction goes first, lanes are interleaved bit by bit
+    for (int lane = 0; lane < laneCount; lane++)
+    {
+        for (int chip = 0; chip < chainLen; chip++)
+        {
+            shifted[(chainLen - 1 - chip) * laneCount + lane] = instrs[lane * chainLen + chip];
+        }
+    }
+    gpiochip_frame(shifted, chainLen);
+}
+
+static int gpiochip_set_lanes(int count)
+{
+    if (count > BCM_BITBANG_MAX_LANES)
+    {
+        return 1;
+    }
+    // A line request can't grow, the lines are requested again
+    int previous = lanes;
+    int status = gpiochip_request(count);
+    if (status != 0)
+    {
+        gpiochip_request(previous);
+    }
+    return status;
+}
+
+static void gpiochip_flush(void)
+{
+    // GPIO_V2_LINE_SET_VALUES_IOCTL returns after the lines are set
+}
+
+static void gpiochip_close(void)
+{
+    close(line_fd);
+    close(chip_fd);
+    line_fd = -1;
+    chip_fd = -1;
+}
+
+static void gpiochip_print_stats(FILE* out)
+{
+    fprintf(out, "gpiochip: %llu instructions, %llu syscalls\n",
+        (unsigned long long)instructions,
+        (unsigned long long)syscalls);
+}
+
+const struct Transport transport_gpiochip = {
+    .name = "gpiochip",
+    .init = gpiochip_init,
+    .write = gpiochip_write,
+    .write_batch = gpiochip_write_batch,
+    .write_chain = gpiochip_write_chain,
+    .set_lanes = gpiochip_set_lanes,
+    .flush = gpiochip_flush,
+    .close = gpiochip_close,
+    .print_stats = gpiochip_print_stats
+};
@@ -0,0 +1,210 @@
+#include <stdio.h>
+#include <string.h>
+#include "transport.h"
+#include "max7219_types.h"
+
+/** @brief Segment bits of a digit register with decoding off, DP is bit 7 */
+#define SIM_SEG_DP 0x80
+#define SIM_SEG_A 0x40
+#define SIM_SEG_B 0x20
+#define SIM_SEG_C 0x10
+#define SIM_SEG_D 0x08
+#define SIM_SEG_E 0x04
+#define SIM_SEG_F 0x02
+#define SIM_SEG_G 0x01
+
+/** @brief Code B font, used for digits whose decode mode bit is set */
+static const uint8_t codeB[16] = {
+    CHAR_ZERO, CHAR_ONE, CHAR_TWO, CHAR_THREE, CHAR_FOUR,
+    CHAR_FIVE, CHAR_SIX, CHAR_SEVEN, CHAR_EIGHT, CHAR_NINE,
+    CHAR_MINUS, CHAR_E, CHAR_H_UPPER, CHAR_L_UPPER, CHAR_P, CHAR_EMPTY
+};
+
+/** @brief A simulated MAX7219, its 16-bit shift register and register file */
+struct SimChip
+{
+    uint16_t shift;
+    uint8_t regs[TRANSPORT_REG_COUNT];
+};
+
+/** @brief Every chip of every lane, chip 0 of a lane is wired to the Pi */
+static struct SimChip chips[TRANSPORT_MAX_LANES][TRANSPORT_MAX_CHAIN_LEN];
+
+/** @brief Shape of the simulated sign */
+static int chainLen = 1;
+static int lanes = 1;
+
+/** @brief Instructions shifted in and LOAD frames latched */
+static uint64_t instructions;
+static uint64_t frames;
+
+static int sim_init(void)
+{
+    // Power-up state, shut down with every register cleared
+    memset(chips, 0, sizeof(chips));
+    chainLen = 1;
+    lanes = 1;
+    instructions = 0;
+    frames = 0;
+    return 0;
+}
+
+/** @brief Shifts 16 bits into chip 0 of a lane, every chip passes its old bits on through DOUT */
+static void sim_shift(int lane, uint16_t instr)
+{
+    for (int chip = chainLen - 1; chip > 0; chip--)
+    {
+        chips[lane][chip].shift = chips[lane][chip - 1].shift;
+    }
+    chips[lane][0].shift = instr;
+    instructions++;
+}
+
+/** @brief Rising LOAD, every chip executes the instruction in its shift register */
+static void sim_latch(void)
+{
+    for (int lane = 0; lane < lanes; lane++)
+    {
+        for (int chip = 0; chip < chainLen; chip++)
+        {
+            struct SimChip* c = &chips[lane][chip];
+            uint8_t reg = (c->shift >> 8) & (TRANSPORT_REG_COUNT - 1);
+
+            if (reg != REG_NO_OP)
+            {
+                c->regs[reg] = c->shift & 0xFF;
+            }
+        }
+    }
+    frames++;
+}
+
+static void sim_write_batch(const uint16_t* instrs, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        sim_shift(0, instrs[i]);
+        sim_latch();
+    }
+}
+
+static void sim_write(uint8_t reg, uint8_t val)
+{
+    uint16_t instr = TRANSPORT_INSTR(reg, val);
+    sim_write_batch(&instr, 1);
+}
+
+static void sim_write_chain(const uint16_t* instrs, int len, int laneCount)
+{
+    // The farthest chip's instruction is shifted in first
+    for (int lane = 0; lane < laneCount; lane++)
+    {
+        for (int chip = len - 1; chip >= 0; chip--)
+        {
+            sim_shift(lane, instrs[lane * len + chip]);
+        }
+    }
+    sim_latch();
+}
+
+static int sim_set_chain_len(int len)
+{
+    chainLen = len;
+    return 0;
+}
+
+static int sim_set_lanes(int count)
+{
+    lanes = count;
+    return 0;
+}
+
+static void sim_flush(void)
+{
+    // Every instruction is executed as soon as it is written
+}
+
+static void sim_close(void)
+{
+}
+
+/**
+ * @brief Segments lit on a digit, after display test, shutdown, scan limit and decode mode
+ * @param digit 0 is the rightmost digit
+ */
+static uint8_t sim_segments(const struct SimChip* c, int digit)
+{
+    if (c->regs[REG_DISPLAY_TEST] & TEST_MODE_ON)
+    {
+        return 0xFF;
+    }
+    if (!(c->regs[REG_SHUTDOWN] & SHUTDOWN_5V) || digit > (c->regs[REG_SCAN_LIMIT] & SCAN_LIMIT_7))
+    {
+        return CHAR_EMPTY;
+    }
+
+    uint8_t val = c->regs[REG_DIGIT_0 + digit];
+    if (c->regs[REG_DECODE_MODE] & (1 << digit))
+    {
+        return codeB[val & 0x0F] | (val & SIM_SEG_DP);
+    }
+    return val;
+}
+
+/** @brief Renders every lane as three rows of ASCII segments, chip 0 and digit 7 leftmost */
+static void sim_render(FILE* out)
+{
+    for (int lane = 0; lane < lanes; lane++)
+    {
+        char rows[3][TRANSPORT_MAX_CHAIN_LEN * TRANSPORT_FRAME_LEN * 4 + 1];
+        int col = 0;
+
+        for (int chip = 0; chip < chainLen; chip++)
+        {
+            for (int digit = TRANSPORT_FRAME_LEN - 1; digit >= 0; digit--)
+            {
+                uint8_t s = sim_segments(&chips[lane][chip], digit);
+
+                memcpy(&rows[0][col], (char[]){' ', s & SIM_SEG_A ? '_' : ' ', ' ', ' '}, 4);
+                memcpy(&rows[1][col], (char[]){s & SIM_SEG_F ? '|' : ' ', s & SIM_SEG_G ? '_' : ' ',
+                    s & SIM_SEG_B ? '|' : ' ', ' '}, 4);
+                memcpy(&rows[2][col], (char[]){s & SIM_SEG_E ? '|' : ' ', s & SIM_SEG_D ? '_' : ' ',
+                    s & SIM_SEG_C ? '|' : ' ', s & SIM_SEG_DP ? '.' : ' '}, 4);
+                col += 4;
+            }
+        }
+        for (int row = 0; row < 3; row++)
+        {
+            rows[row][col] = '\0';
+            fprintf(out, "%s\n", rows[row]);
+        }
+
+        fprintf(out, "lane %d intensity:", lane);
+        for (int chip = 0; chip < chainLen; chip++)
+        {
+            fprintf(out, " %d/32", (chips[lane][chip].regs[REG_INTENSITY] & INTENSITY_31_32) * 2 + 1);
+        }
+        fprintf(out, "\n");
+    }
+}
+
+static void sim_print_stats(FILE* out)
+{
+    fprintf(out, "sim: %llu instructions, %llu frames\n",
+        (unsigned long long)instructions,
+        (unsigned long long)frames);
+    sim_render(out);
+}
+
+const struct Transport transport_sim = {
+    .name = "sim",
+    .init = sim_init,
+    .write = sim_write,
+    .write_batch = sim_write_batch,
+    .write_chain = sim_write_chain,
+    .set_chain_len = sim_set_chain_len,
+    .set_lanes = sim_set_lanes,
+    .flush = sim_flush,
+    .close = sim_close,
+    .print_stats = sim_print_stats
+};
@@ -0,0 +1,172 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/spi/spidev.h>
+#include "transport.h"
+
+/** @brief spidev device of SPI0 CE0, doesn't need root with the spi group */
+#define SPIDEV_DEV_FN "/dev/spidev0.0"
+
+/** @brief Bus speed if DISPLAY_SPIDEV_HZ isn't set, and the fastest one, the MAX7219 is rated for 10 MHz */
+#define SPIDEV_SPEED_HZ 1000000
+#define SPIDEV_MAX_SPEED_HZ 10000000
+
+#define SPIDEV_INSTR_LEN 2
+
+/** @brief File descriptor for the spidev device */
+static int spidev_fd = -1;
+
+/** @brief Tx buffers of the current message, one instruction or chain frame per transfer */
+static uint8_t txBuff[TRANSPORT_REG_COUNT][SPIDEV_INSTR_LEN * TRANSPORT_MAX_CHAIN_LEN];
+
+/** @brief Transfers of the current message */
+static struct spi_ioc_transfer transfers[TRANSPORT_REG_COUNT];
+
+/** @brief Bus speed in use */
+static uint32_t speedHz = SPIDEV_SPEED_HZ;
+
+static int spidev_sys_ioctl(int fd, unsigned long request, void* arg)
+{
+    return ioctl(fd, request, arg);
+}
+
+int (*transport_spidev_ioctl)(int fd, unsigned long request, void* arg) = spidev_sys_ioctl;
+
+/** @brief SPI_IOC_MESSAGE syscalls and transfers sent */
+static uint64_t messages;
+static uint64_t transferCount;
+
+static int spidev_init(void)
+{
+    uint8_t mode = SPI_MODE_0;
+    uint8_t bits = 8;
+
+    // The bus speed can be raised up to the MAX7219's 10 MHz, for short wires
+    const char* speedEnv = getenv("DISPLAY_SPIDEV_HZ");
+    int speed = speedEnv != NULL ? atoi(speedEnv) : 0;
+    speedHz = SPIDEV_SPEED_HZ;
+    if (speed > 0)
+    {
+        speedHz = speed < SPIDEV_MAX_SPEED_HZ ? speed : SPIDEV_MAX_SPEED_HZ;
+    }
+
+    spidev_fd = open(SPIDEV_DEV_FN, O_RDWR);
+    if (spidev_fd < 0)
+    {
+        printf("ERROR: \"%s\" not opened!\n", SPIDEV_DEV_FN);
+        return 7;
+    }
+    if (transport_spidev_ioctl(spidev_fd, SPI_IOC_WR_MODE, &mode) < 0 ||
+        transport_spidev_ioctl(spidev_fd, SPI_IOC_WR_BITS_PER_WORD, &bits) < 0 ||
+        transport_spidev_ioctl(spidev_fd, SPI_IOC_WR_MAX_SPEED_HZ, &speedHz) < 0)
+    {
+        printf("ERROR: \"%s\" not configured!\n", SPIDEV_DEV_FN);
+        close(spidev_fd);
+        spidev_fd = -1;
+        return 8;
+    }
+    printf("spidev %s opened at %u Hz, %d!\n", SPIDEV_DEV_FN, speedHz, spidev_fd);
+    return 0;
+}
+
+/** @brief Sends the first `count` transfers as one message, CS toggles between them */
+static void spidev_send(int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        // CS is released after the last transfer anyway, cs_change there would keep it low
+        transfers[i].cs_change = i < count - 1;
+    }
+    if (transport_spidev_ioctl(spidev_fd, SPI_IOC_MESSAGE(count), transfers) < 0)
+    {
+        printf("ERROR: spidev message of %d transfers not sent!\n", count);
+        return;
+    }
+    messages++;
+    transferCount += count;
+}
+
+/** @brief Points the i-th transfer at its tx buffer holding `len` bytes */
+static void spidev_prepare(int i, int len)
+{
+    memset(&transfers[i], 0, sizeof(transfers[i]));
+    transfers[i].tx_buf = (uintptr_t)txBuff[i];
+    transfers[i].len = len;
+}
+
+static void spidev_write_batch(const uint16_t* instrs, int count)
+{
+    int pending = 0;
+
+    // Every instruction is its own CS frame, a whole frame is one syscall
+    for (int i = 0; i < count; i++)
+    {
+        txBuff[pending][0] = instrs[i] >> 8;
+        txBuff[pending][1] = instrs[i] & 0xFF;
+        spidev_prepare(pending++, SPIDEV_INSTR_LEN);
+
+        if (pending == TRANSPORT_REG_COUNT)
+        {
+            spidev_send(pending);
+            pending = 0;
+        }
+    }
+    if (pending > 0)
+    {
+        spidev_send(pending);
+    }
+}
+
+static void spidev_write(uint8_t reg, uint8_t val)
+{
+    uint16_t instr = TRANSPORT_INSTR(reg, val);
+    spidev_write_batch(&instr, 1);
+}
+
+static void spidev_write_chain(const uint16_t* instrs, int chainLen, int lanes)
+{
+    // Single MOSI line, lanes is always 1
+    (void)lanes;
+    // The farthest chip's instruction goes first
+    for (int chip = 0; chip < chainLen; chip++)
+    {
+        int offset = (chainLen - 1 - chip) * SPIDEV_INSTR_LEN;
+        txBuff[0][offset] = instrs[chip] >> 8;
+        txBuff[0][offset + 1] = instrs[chip] & 0xFF;
+    }
+    spidev_prepare(0, chainLen * SPIDEV_INSTR_LEN);
+    spidev_send(1);
+}
+
+static void spidev_flush(void)
+{
+    // SPI_IOC_MESSAGE returns only after the message is sent
+}
+
+static void spidev_close(void)
+{
+    close(spidev_fd);
+    spidev_fd = -1;
+}
+
+static void spidev_print_stats(FILE* out)
+{
+    fprintf(out, "spidev: %llu messages, %llu transfers, %u Hz\n",
+        (unsigned long long)messages,
+        (unsigned long long)transferCount,
+        speedHz);
+}
+
+const struct Transport transport_spidev = {
+    .name = "spidev",
+    .init = spidev_init,
+    .write = spidev_write,
+    .write_batch = spidev_write_batch,
+    .write_chain = spidev_write_chain,
+    .flush = spidev_flush,
+    .close = spidev_close,
+    .print_stats = spidev_print_stats
+};